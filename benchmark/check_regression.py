@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+# Copyright contributors to the onnxmlir-triton-backend project
+
+"""Fails when a benchmark got slower than the baseline.
+
+Compares the mean cpu_time of every benchmark in two google/benchmark
+JSON result files and exits with 1 if any benchmark of the baseline is
+missing from the result or slower by more than the threshold. Needs
+nothing but the python3 standard library.
+
+usage: check_regression.py <baseline.json> <result.json> [threshold]
+"""
+
+import json
+import sys
+
+TIME_UNITS = {"ns": 1.0, "us": 1e3, "ms": 1e6, "s": 1e9}
+
+
+def load_means(path):
+    with open(path) as f:
+        benchmarks = json.load(f)["benchmarks"]
+    iterations = {}
+    means = {}
+    for bm in benchmarks:
+        if bm.get("error_occurred"):
+            continue
+        name = bm.get("run_name", bm["name"])
+        cpu_time = bm["cpu_time"] * TIME_UNITS[bm.get("time_unit", "ns")]
+        if bm.get("run_type") == "aggregate":
+            if bm.get("aggregate_name") == "mean":
+                means[name] = cpu_time
+        else:
+            iterations.setdefault(name, []).append(cpu_time)
+    # Runs without --benchmark_repetitions have no aggregates.
+    for name, times in iterations.items():
+        means.setdefault(name, sum(times) / len(times))
+    return means
+
+
+def main(argv):
+    if len(argv) not in (3, 4):
+        sys.stderr.write(__doc__)
+        return 2
+    threshold = float(argv[3]) if len(argv) == 4 else 0.10
+    try:
+        baseline = load_means(argv[1])
+    except IOError as e:
+        sys.stderr.write("no baseline: %s\n" % e)
+        return 1
+    result = load_means(argv[2])
+
+    failed = False
+    for name in sorted(baseline):
+        if name not in result:
+            print("%-50s missing from result" % name)
+            failed = True
+            continue
+        change = result[name] / baseline[name] - 1.0 if baseline[name] > 0 else 0.0
+        regressed = change > threshold
+        print("%-50s %12.1f ns %12.1f ns %+7.1f%%%s" % (
+            name, baseline[name], result[name], change * 100,
+            "  REGRESSION" if regressed else ""))
+        failed = failed or regressed
+    if failed:
+        print("benchmarks regressed by more than %.1f%%" % (threshold * 100))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
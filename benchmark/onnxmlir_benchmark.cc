@@ -0,0 +1,224 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+// Microbenchmarks of the model load and per batch helpers of the
+// backend. They run offline: the model config and entry point
+// signatures are generated and model.so is replaced by a fake library.
+
+#include <benchmark/benchmark.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+#include "model_state.h"
+#include "onnxmlir_typemapping.h"
+#include "quantization.h"
+#include "triton/common/triton_json.h"
+
+#include "rapidjson/document.h"
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+namespace {
+
+// A config data type and the MLIR type of its signature.
+struct TypePair {
+  const char *config_type;
+  const char *mlir_type;
+};
+
+const TypePair TYPES[] = {
+    {"TYPE_FP32", "f32"}, {"TYPE_INT64", "i64"}, {"TYPE_INT32", "i32"},
+    {"TYPE_FP64", "f64"}, {"TYPE_UINT8", "ui8"}, {"TYPE_BOOL", "i1"}};
+const size_t NUM_TYPES = sizeof(TYPES) / sizeof(TYPES[0]);
+
+// Per tensor dims without the batch dimension, from image to token
+// id inputs.
+const std::vector<std::vector<int64_t>> DIMS = {
+    {3, 224, 224}, {128}, {16, 64}, {1}, {4, 32, 32, 8}};
+
+std::string DimsString(const std::vector<int64_t> &dims, bool batched){
+  std::string ret = "[";
+  if(batched)
+    ret += "-1";
+  for(size_t d = 0; d < dims.size(); d++){
+    if(batched || d > 0)
+      ret += " , ";
+    ret += std::to_string(dims[d]);
+  }
+  return ret + "]";
+}
+
+// Model with 'num_tensors' tensors of mixed types and ranks: the
+// TensorDefs of its config and the signature emitted by onnx-mlir.
+struct Model {
+  std::vector<TensorDef> config;
+  TensorIndex index;
+  std::string signature;
+};
+
+Model MakeModel(size_t num_tensors){
+  Model model;
+  model.signature = "[";
+  for(size_t i = 0; i < num_tensors; i++){
+    const TypePair &type = TYPES[i % NUM_TYPES];
+    const std::vector<int64_t> &dims = DIMS[i % DIMS.size()];
+    std::string name = "input_" + std::to_string(i);
+    common::TritonJson::Value tensor;
+    std::string tensor_config = "{\"name\":\"" + name + "\",\"data_type\":\"" +
+        type.config_type + "\",\"dims\":" + DimsString(dims, false) + "}";
+    tensor.Parse(tensor_config);
+    model.config.emplace_back(tensor, true);
+    if(i > 0)
+      model.signature += " ,\n";
+    model.signature += "    { \"type\" : \"" + std::string(type.mlir_type) +
+        "\" , \"dims\" : " + DimsString(dims, true) + " , \"name\" : \"" + name + "\" }";
+  }
+  model.signature += "\n]";
+  model.index = BuildTensorIndex(model.config);
+  return model;
+}
+
+//
+// FakeModelLibrary
+//
+// Model library without model.so whose OMTensor accessors work on
+// FakeTensor.
+//
+struct FakeTensor {
+  OM_DATA_TYPE dtype;
+  int64_t rank;
+  int64_t *shape;
+};
+
+FakeTensor* Fake(OMTensor *tensor){
+  return reinterpret_cast<FakeTensor*>(tensor);
+}
+
+class FakeModelLibrary : public ModelLibrary {
+ public:
+  FakeModelLibrary() : ModelLibrary("fake", 0, 0){
+    dll_omQueryEntryPoints = nullptr;
+    dll_omInputSignature = nullptr;
+    dll_omOutputSignature = nullptr;
+    dll_run_main_graph = nullptr;
+    dll_omTensorCreate = nullptr;
+    dll_omTensorListCreate = nullptr;
+    dll_omTensorListGetOmtByIndex = nullptr;
+    dll_omTensorGetDataPtr = nullptr;
+    dll_omTensorGetRank = [](OMTensor *t){ return Fake(t)->rank; };
+    dll_omTensorGetShape = [](OMTensor *t){ return Fake(t)->shape; };
+    dll_omTensorGetDataType = [](OMTensor *t){ return Fake(t)->dtype; };
+    dll_omTensorDestroy = nullptr;
+    dll_omTensorListGetSize = nullptr;
+    dll_omTensorListDestroy = nullptr;
+  }
+};
+
+void BM_MlirDataTypeToOmDataType(benchmark::State &state){
+  const char *types[] = {"f32", "i64", "i1", "ui8", "complex<f64>", "bf16"};
+  for(auto _ : state){
+    for(const char *type : types)
+      benchmark::DoNotOptimize(MlirDataTypeToOmDataType(type));
+  }
+  state.SetItemsProcessed(state.iterations() * 6);
+}
+BENCHMARK(BM_MlirDataTypeToOmDataType);
+
+// As parsed from a signature, without a std::string per lookup.
+void BM_MlirDataTypeToOmDataTypeChars(benchmark::State &state){
+  const char *types[] = {"f32", "i64", "i1", "ui8", "complex<f64>", "bf16"};
+  size_t lengths[6];
+  for(int t = 0; t < 6; t++)
+    lengths[t] = strlen(types[t]);
+  for(auto _ : state){
+    for(int t = 0; t < 6; t++)
+      benchmark::DoNotOptimize(MlirDataTypeToOmDataType(types[t], lengths[t]));
+  }
+  state.SetItemsProcessed(state.iterations() * 6);
+}
+BENCHMARK(BM_MlirDataTypeToOmDataTypeChars);
+
+// Load time signature validation of a model with range(0) inputs.
+void BM_CheckSignature(benchmark::State &state){
+  Model model = MakeModel(state.range(0));
+  std::string error;
+  for(auto _ : state){
+    if(!CheckSignature(model.signature.c_str(), model.config, model.index, error)){
+      state.SkipWithError(("signature mismatch: " + error).c_str());
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  state.SetBytesProcessed(state.iterations() * model.signature.size());
+}
+BENCHMARK(BM_CheckSignature)->Arg(1)->Arg(16)->Arg(256)->Arg(1024);
+
+// Per batch validation of the outputs of a model with range(0) outputs.
+void BM_CheckTensorMatches(benchmark::State &state){
+  Model model = MakeModel(state.range(0));
+  FakeModelLibrary library;
+  std::vector<std::vector<int64_t>> shapes;
+  std::vector<FakeTensor> tensors;
+  for(TensorDef &def : model.config){
+    shapes.push_back(def.shape);
+    shapes.back()[0] = 8;
+  }
+  for(size_t i = 0; i < model.config.size(); i++)
+    tensors.push_back({model.config[i].om_dtype, (int64_t)shapes[i].size(), shapes[i].data()});
+  std::string error;
+  for(auto _ : state){
+    for(size_t i = 0; i < tensors.size(); i++){
+      if(!model.config[i].CheckTensorMatches(
+             &library, reinterpret_cast<OMTensor*>(&tensors[i]), error)){
+        state.SkipWithError(("tensor mismatch: " + error).c_str());
+        return;
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_CheckTensorMatches)->Arg(1)->Arg(16)->Arg(256);
+
+// Batch dimension inference of an input of rank range(0).
+void BM_BatchSize(benchmark::State &state){
+  Model model = MakeModel(1);
+  std::vector<int64_t> shape(state.range(0), 4);
+  size_t byte_size = 32 * model.config[0].dtype_size;
+  for(int64_t d = 1; d < state.range(0); d++)
+    byte_size *= shape[d];
+  for(auto _ : state){
+    benchmark::DoNotOptimize(
+        model.config[0].BatchSize(shape.data(), shape.size(), byte_size));
+  }
+}
+BENCHMARK(BM_BatchSize)->Arg(1)->Arg(4)->Arg(8);
+
+// Dequantization of range(0) uint8 elements during the gather.
+void BM_Dequantize(benchmark::State &state){
+  std::vector<uint8_t> wire(state.range(0), 200);
+  std::vector<float> model(state.range(0));
+  for(auto _ : state){
+    Dequantize(wire.data(), model.data(), wire.size(), 0.0078125f, 128);
+    benchmark::DoNotOptimize(model.data());
+  }
+  state.SetBytesProcessed(state.iterations() * wire.size());
+}
+BENCHMARK(BM_Dequantize)->Arg(512)->Arg(150528);
+
+// Quantization of range(0) float elements during the scatter.
+void BM_Quantize(benchmark::State &state){
+  std::vector<float> model(state.range(0), 0.5f);
+  std::vector<uint8_t> wire(state.range(0));
+  for(auto _ : state){
+    Quantize(model.data(), wire.data(), model.size(), 0.0078125f, 128);
+    benchmark::DoNotOptimize(wire.data());
+  }
+  state.SetBytesProcessed(state.iterations() * wire.size());
+}
+BENCHMARK(BM_Quantize)->Arg(512)->Arg(150528);
+
+}  // namespace
+
+}}}  // namespace triton::backend::onnxmlir
+
+BENCHMARK_MAIN();
@@ -0,0 +1,123 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#ifndef ONNX_MLIR_ALIGNED_BUFFER_H
+#define ONNX_MLIR_ALIGNED_BUFFER_H
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sys/mman.h>
+#include "numa.h"
+#include "triton/backend/backend_common.h"
+
+// Alignment of the buffers the inputs are gathered into, overridden per
+// model with the 'input_alignment' parameter.
+#ifndef ONNXMLIR_DEFAULT_ALIGNMENT
+#define ONNXMLIR_DEFAULT_ALIGNMENT 64
+#endif
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+//
+// AlignedBuffer
+//
+// Reusable heap buffer with a given alignment. The usable size is
+// rounded up to a multiple of the alignment and the padding is zeroed,
+// so vectorized loops may read whole vectors past the end of the data.
+// With a NUMA node set the memory is mapped directly, rather than taken
+// from the malloc heap, and bound to the node.
+//
+class AlignedBuffer {
+ public:
+  AlignedBuffer() = default;
+  AlignedBuffer(const AlignedBuffer&) = delete;
+  AlignedBuffer& operator=(const AlignedBuffer&) = delete;
+  AlignedBuffer(AlignedBuffer &&other) noexcept
+      : data_(other.data_), capacity_(other.capacity_), alignment_(other.alignment_),
+        numa_node_(other.numa_node_), mapped_(other.mapped_), bound_(other.bound_){
+    other.data_ = nullptr;
+    other.capacity_ = 0;
+    other.mapped_ = false;
+    other.bound_ = false;
+  }
+  ~AlignedBuffer() { Release(); }
+
+  // Place future allocations on NUMA 'node', -1 for no placement.
+  void SetNumaNode(int node){ numa_node_ = node; }
+  // Whether the current allocation is bound to the NUMA node.
+  bool Bound() const { return bound_; }
+
+  // Get a buffer for 'byte_size' bytes, the previous content is lost.
+  // Returns nullptr if the allocation fails.
+  char* Reserve(size_t byte_size, size_t alignment){
+    size_t padded = (byte_size + alignment - 1) / alignment * alignment;
+    if(padded == 0)
+      padded = alignment;
+    if(padded > capacity_ || alignment != alignment_){
+      Release();
+      if(numa_node_ >= 0){
+        if(!Map(padded, alignment))
+          return nullptr;
+        TRITONSERVER_Error *err = BindMemoryToNumaNode(data_, capacity_, numa_node_);
+        bound_ = err == nullptr;
+        LOG_IF_ERROR(err, "failed to place buffer");
+      } else {
+        void *ptr;
+        if(posix_memalign(&ptr, alignment, padded) != 0)
+          return nullptr;
+        data_ = (char*)ptr;
+        capacity_ = padded;
+      }
+      alignment_ = alignment;
+    }
+    memset(data_ + byte_size, 0, padded - byte_size);
+    return data_;
+  }
+
+ private:
+  // Map whole pages for mbind, binding heap memory would also move
+  // the pages of neighbouring allocations.
+  bool Map(size_t padded, size_t alignment){
+    const size_t page_size = PageSize();
+    const size_t size = (padded + page_size - 1) / page_size * page_size;
+    // Alignments above the page size: map more and unmap the excess.
+    const size_t extra = alignment > page_size ? alignment - page_size : 0;
+    void *ptr = mmap(nullptr, size + extra, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(ptr == MAP_FAILED)
+      return false;
+    char *base = (char*)ptr;
+    char *aligned = (char*)(((uintptr_t)base + alignment - 1) / alignment * alignment);
+    if(aligned > base)
+      munmap(base, aligned - base);
+    if(base + extra > aligned)
+      munmap(aligned + size, base + extra - aligned);
+    data_ = aligned;
+    capacity_ = size;
+    mapped_ = true;
+    return true;
+  }
+
+  void Release(){
+    if(mapped_)
+      munmap(data_, capacity_);
+    else
+      free(data_);
+    data_ = nullptr;
+    capacity_ = 0;
+    mapped_ = false;
+    bound_ = false;
+  }
+
+  char *data_ = nullptr;
+  size_t capacity_ = 0;
+  size_t alignment_ = 0;
+  int numa_node_ = -1;
+  // data_ is an mmap()ed region of capacity_ bytes rather than heap memory
+  bool mapped_ = false;
+  bool bound_ = false;
+};
+
+}}}  // namespace triton::backend::onnxmlir
+
+#endif //ONNX_MLIR_ALIGNED_BUFFER_H
@@ -0,0 +1,159 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#include "backend_state.h"
+#include "onnxmlir_trace.h"
+#include "triton/core/tritonbackend.h"
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+namespace {
+
+TRITONSERVER_Error* ParseCmdlineBool(
+    common::TritonJson::Value &cmdline, const char *key, bool *value, bool default_value){
+  std::string str;
+  if(!cmdline.Find(key)){
+    *value = default_value;
+    return nullptr;
+  }
+  RETURN_IF_ERROR(cmdline.MemberAsString(key, &str));
+  return ParseBoolValue(str, value);
+}
+
+TRITONSERVER_Error* ParseCmdlineUInt(
+    common::TritonJson::Value &cmdline, const char *key, uint64_t *value, uint64_t default_value){
+  std::string str;
+  if(!cmdline.Find(key)){
+    *value = default_value;
+    return nullptr;
+  }
+  RETURN_IF_ERROR(cmdline.MemberAsString(key, &str));
+  return ParseUnsignedLongLongValue(str, value);
+}
+
+}  // namespace
+
+TRITONSERVER_Error*
+BackendState::Create(TRITONBACKEND_Backend* triton_backend, BackendState** state){
+  TRITONSERVER_Message* backend_config_message;
+  RETURN_IF_ERROR(TRITONBACKEND_BackendConfig(triton_backend, &backend_config_message));
+  const char* buffer;
+  size_t byte_size;
+  RETURN_IF_ERROR(TRITONSERVER_MessageSerializeToJson(
+      backend_config_message, &buffer, &byte_size));
+  LOG_VERBOSE((std::string("onnxmlir backend config: ") + std::string(buffer, byte_size)).c_str());
+
+  common::TritonJson::Value backend_config;
+  common::TritonJson::Value cmdline;
+  if(byte_size != 0)
+    RETURN_IF_ERROR(backend_config.Parse(buffer, byte_size));
+  bool has_cmdline = byte_size != 0 && backend_config.Find("cmdline", &cmdline);
+
+  bool share_libraries = true;
+  bool prefetch_libraries = false;
+  uint64_t library_memory_budget = 0;
+  bool shared_thread_pool = false;
+  uint64_t thread_pool_size = 0;
+  if(has_cmdline){
+    RETURN_IF_ERROR(ParseCmdlineBool(cmdline, "shared-model-libraries", &share_libraries, true));
+    RETURN_IF_ERROR(ParseCmdlineBool(cmdline, "prefetch-model-libraries", &prefetch_libraries, false));
+    RETURN_IF_ERROR(ParseCmdlineUInt(cmdline, "model-library-memory-budget", &library_memory_budget, 0));
+    RETURN_IF_ERROR(ParseCmdlineBool(cmdline, "shared-thread-pool", &shared_thread_pool, false));
+    RETURN_IF_ERROR(ParseCmdlineUInt(cmdline, "thread-pool-size", &thread_pool_size, 0));
+  }
+  *state = new BackendState(share_libraries, prefetch_libraries, library_memory_budget);
+  if(shared_thread_pool){
+    (*state)->pool_.reset(new ComputePool(thread_pool_size));
+    LOG_MESSAGE(TRITONSERVER_LOG_INFO,
+        ("onnxmlir: shared compute pool with " +
+         std::to_string((*state)->pool_->NumThreads()) + " threads").c_str());
+  }
+  return nullptr;  // success
+}
+
+TRITONSERVER_Error*
+BackendState::ForModel(TRITONBACKEND_Model* triton_model, BackendState** state){
+  TRITONBACKEND_Backend* backend;
+  RETURN_IF_ERROR(TRITONBACKEND_ModelBackend(triton_model, &backend));
+  void* vstate;
+  RETURN_IF_ERROR(TRITONBACKEND_BackendState(backend, &vstate));
+  *state = reinterpret_cast<BackendState*>(vstate);
+  return nullptr;  // success
+}
+
+bool BackendState::SignatureValidated(uint64_t content_hash, uint64_t file_size, uint64_t fingerprint){
+  std::lock_guard<std::mutex> lock(signatures_mutex_);
+  return validated_signatures_.count(SignatureKey(content_hash, file_size, fingerprint)) != 0;
+}
+
+void BackendState::AddValidatedSignature(uint64_t content_hash, uint64_t file_size, uint64_t fingerprint){
+  std::lock_guard<std::mutex> lock(signatures_mutex_);
+  validated_signatures_.insert(SignatureKey(content_hash, file_size, fingerprint));
+}
+
+TRITONSERVER_MetricFamily* BackendState::NumaLocalBytesFamily(){
+  std::lock_guard<std::mutex> lock(metrics_mutex_);
+  if(numa_local_bytes_family_ == nullptr && !numa_local_bytes_family_failed_){
+    TRITONSERVER_Error* err = TRITONSERVER_MetricFamilyNew(
+        &numa_local_bytes_family_, TRITONSERVER_METRIC_KIND_COUNTER,
+        "onnxmlir_numa_local_bytes",
+        "Bytes of gathered inputs and quantized outputs placed on the NUMA node of the instance");
+    if(err != nullptr){
+      LOG_MESSAGE(TRITONSERVER_LOG_WARN,
+          (std::string("onnxmlir: NUMA metrics unavailable: ") + TRITONSERVER_ErrorMessage(err)).c_str());
+      TRITONSERVER_ErrorDelete(err);
+      numa_local_bytes_family_ = nullptr;
+      numa_local_bytes_family_failed_ = true;
+    }
+  }
+  return numa_local_bytes_family_;
+}
+
+BackendState::~BackendState(){
+  if(numa_local_bytes_family_)
+    LOG_IF_ERROR(TRITONSERVER_MetricFamilyDelete(numa_local_bytes_family_),
+                 "failed to delete metric family");
+}
+
+extern "C" {
+
+// Triton calls TRITONBACKEND_Initialize when the backend is loaded,
+// before any model using it is initialized.
+//
+TRITONSERVER_Error*
+TRITONBACKEND_Initialize(TRITONBACKEND_Backend* backend)
+{
+  uint32_t api_version_major, api_version_minor;
+  RETURN_IF_ERROR(
+      TRITONBACKEND_ApiVersion(&api_version_major, &api_version_minor));
+  if ((api_version_major != TRITONBACKEND_API_VERSION_MAJOR) ||
+      (api_version_minor < TRITONBACKEND_API_VERSION_MINOR)) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_UNSUPPORTED,
+        "triton backend API version does not support this backend");
+  }
+
+  BackendState* backend_state;
+  RETURN_IF_ERROR(BackendState::Create(backend, &backend_state));
+  RETURN_IF_ERROR(TRITONBACKEND_BackendSetState(
+      backend, reinterpret_cast<void*>(backend_state)));
+
+  return nullptr;  // success
+}
+
+// Triton calls TRITONBACKEND_Finalize when the backend is no longer
+// needed. All models using it have been finalized at this point.
+//
+TRITONSERVER_Error*
+TRITONBACKEND_Finalize(TRITONBACKEND_Backend* backend)
+{
+  void* vstate;
+  RETURN_IF_ERROR(TRITONBACKEND_BackendState(backend, &vstate));
+  BackendState* backend_state = reinterpret_cast<BackendState*>(vstate);
+  delete backend_state;
+
+  return nullptr;  // success
+}
+
+}  // extern "C"
+
+}}}  // namespace triton::backend::onnxmlir
@@ -0,0 +1,59 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#ifndef ONNX_MLIR_BACKEND_STATE_H
+#define ONNX_MLIR_BACKEND_STATE_H
+
+#include "triton/backend/backend_common.h"
+#include "compute_pool.h"
+#include "model_library.h"
+
+#include <memory>
+#include <mutex>
+#include <set>
+#include <tuple>
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+//
+// BackendState
+//
+// State shared by all models using this backend. Created in
+// TRITONBACKEND_Initialize from the backend config given with
+// --backend-config=onnxmlir,<key>=<value>.
+//
+class BackendState {
+ public:
+  static TRITONSERVER_Error* Create(
+      TRITONBACKEND_Backend* triton_backend, BackendState** state);
+  // Get the backend state for 'triton_model'.
+  static TRITONSERVER_Error* ForModel(
+      TRITONBACKEND_Model* triton_model, BackendState** state);
+
+  ModelLibraryRegistry *Libraries() { return &libraries_; }
+  // The shared compute pool, nullptr unless enabled.
+  ComputePool *Pool() { return pool_.get(); }
+  // Whether a library with 'content_hash' and 'file_size' already
+  // passed the signature check against a config with 'fingerprint'.
+  bool SignatureValidated(uint64_t content_hash, uint64_t file_size, uint64_t fingerprint);
+  void AddValidatedSignature(uint64_t content_hash, uint64_t file_size, uint64_t fingerprint);
+  // Counter family of the bytes NUMA bound instances placed on their
+  // node, created on first use. nullptr if the server has no metrics.
+  TRITONSERVER_MetricFamily* NumaLocalBytesFamily();
+  ~BackendState();
+
+ private:
+  BackendState(bool share_libraries, bool prefetch_libraries, uint64_t library_memory_budget)
+      : libraries_(share_libraries, prefetch_libraries, library_memory_budget) {}
+  typedef std::tuple<uint64_t, uint64_t, uint64_t> SignatureKey;
+  ModelLibraryRegistry libraries_;
+  std::unique_ptr<ComputePool> pool_;
+  std::mutex signatures_mutex_;
+  std::set<SignatureKey> validated_signatures_;
+  std::mutex metrics_mutex_;
+  TRITONSERVER_MetricFamily* numa_local_bytes_family_ = nullptr;
+  bool numa_local_bytes_family_failed_ = false;
+};
+
+}}}  // namespace triton::backend::onnxmlir
+
+#endif //ONNX_MLIR_BACKEND_STATE_H
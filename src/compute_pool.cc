@@ -0,0 +1,128 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#include "compute_pool.h"
+
+#include <algorithm>
+#include <chrono>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+namespace {
+
+// Pass increment per microsecond of run time of a queue with weight 1.
+const uint64_t STRIDE_BASE = 1 << 20;
+
+uint64_t NowUs(){
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+size_t AvailableCpus(){
+#ifdef __linux__
+  cpu_set_t cpus;
+  if(sched_getaffinity(0, sizeof(cpus), &cpus) == 0)
+    return CPU_COUNT(&cpus);
+#endif
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+}  // namespace
+
+ComputePool::ComputePool(size_t num_threads){
+  if(num_threads == 0)
+    num_threads = AvailableCpus();
+  for(size_t i = 0; i < num_threads; i++)
+    workers_.emplace_back(&ComputePool::WorkerLoop, this);
+}
+
+ComputePool::~ComputePool(){
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for(auto &worker : workers_)
+    worker.join();
+  for(Queue *queue : queues_)
+    delete queue;
+}
+
+ComputePool::Queue* ComputePool::CreateQueue(uint32_t weight){
+  // weights above STRIDE_BASE would round the stride down to 0 and the
+  // queue's pass would never advance, starving all other queues
+  Queue *queue = new Queue(std::max<uint64_t>(STRIDE_BASE / std::max(weight, 1u), 1));
+  std::lock_guard<std::mutex> lock(mutex_);
+  queues_.insert(queue);
+  return queue;
+}
+
+void ComputePool::DestroyQueue(Queue *queue){
+  std::unique_lock<std::mutex> lock(mutex_);
+  // Run() returns before the worker charged the task to the queue
+  idle_cv_.wait(lock, [queue](){ return queue->running_ == 0; });
+  queues_.erase(queue);
+  delete queue;
+}
+
+void ComputePool::Run(Queue *queue, const std::function<void()> &task){
+  std::mutex done_mutex;
+  std::condition_variable done_cv;
+  bool done = false;
+  Submit(queue, [&](){
+    task();
+    std::lock_guard<std::mutex> lock(done_mutex);
+    done = true;
+    done_cv.notify_one();
+  });
+  std::unique_lock<std::mutex> lock(done_mutex);
+  done_cv.wait(lock, [&](){ return done; });
+}
+
+void ComputePool::Submit(Queue *queue, std::function<void()> task){
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // a queue coming back from idle starts at the current pass instead
+    // of catching up on the time it had nothing to do
+    if(queue->tasks_.empty())
+      queue->pass_ = std::max(queue->pass_, global_pass_);
+    queue->tasks_.push_back(std::move(task));
+    pending_++;
+  }
+  cv_.notify_one();
+}
+
+void ComputePool::WorkerLoop(){
+  std::unique_lock<std::mutex> lock(mutex_);
+  while(true){
+    cv_.wait(lock, [this](){ return stop_ || pending_ > 0; });
+    if(pending_ == 0)
+      return;
+    Queue *next = nullptr;
+    for(Queue *queue : queues_){
+      if(!queue->tasks_.empty() && (next == nullptr || queue->pass_ < next->pass_))
+        next = queue;
+    }
+    std::function<void()> task = std::move(next->tasks_.front());
+    next->tasks_.pop_front();
+    pending_--;
+    global_pass_ = next->pass_;
+    const uint64_t charged_us = next->estimate_us_;
+    next->pass_ += next->stride_ * charged_us;
+    next->running_++;
+    lock.unlock();
+    const uint64_t start_us = NowUs();
+    task();
+    const uint64_t elapsed_us = std::max<uint64_t>(NowUs() - start_us, 1);
+    lock.lock();
+    next->pass_ = next->pass_ - next->stride_ * charged_us + next->stride_ * elapsed_us;
+    next->estimate_us_ = elapsed_us;
+    if(--next->running_ == 0)
+      idle_cv_.notify_all();
+  }
+}
+
+}}}  // namespace triton::backend::onnxmlir
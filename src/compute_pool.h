@@ -0,0 +1,77 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#ifndef ONNX_MLIR_COMPUTE_POOL_H
+#define ONNX_MLIR_COMPUTE_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+//
+// ComputePool
+//
+// Backend wide pool of worker threads shared by all models. Each model
+// submits its work through its own Queue and the workers pick the next
+// task by stride scheduling over the queues. A queue is charged its
+// stride for every microsecond its tasks run, so a model with weight 2
+// gets twice the share of the CPU of a model with weight 1 when both
+// have work queued, however long their batches take. Idle queues do not
+// accumulate credit.
+//
+class ComputePool {
+ public:
+  class Queue;
+
+  // 'num_threads' 0 sizes the pool to the CPUs available to the process.
+  explicit ComputePool(size_t num_threads);
+  ~ComputePool();
+  size_t NumThreads() const { return workers_.size(); }
+
+  Queue* CreateQueue(uint32_t weight);
+  // The queue must not have any pending tasks, waits for running ones
+  // to be charged.
+  void DestroyQueue(Queue *queue);
+
+  // Run 'task' on a worker of the pool and wait for it to complete.
+  void Run(Queue *queue, const std::function<void()> &task);
+  // Queue 'task' to run on a worker of the pool.
+  void Submit(Queue *queue, std::function<void()> task);
+
+ private:
+  void WorkerLoop();
+
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  // signaled when a queue has no more running tasks
+  std::condition_variable idle_cv_;
+  std::set<Queue*> queues_;
+  size_t pending_ = 0;
+  uint64_t global_pass_ = 0;
+  bool stop_ = false;
+};
+
+class ComputePool::Queue {
+ private:
+  friend class ComputePool;
+  explicit Queue(uint64_t stride) : stride_(stride) {}
+  uint64_t stride_;
+  uint64_t pass_ = 0;
+  // Run time in microseconds of the last task, charged up front when a
+  // task starts so concurrent workers do not all pick the same queue,
+  // and corrected by the actual run time when it finishes.
+  uint64_t estimate_us_ = 1;
+  int running_ = 0;
+  std::deque<std::function<void()>> tasks_;
+};
+
+}}}  // namespace triton::backend::onnxmlir
+
+#endif //ONNX_MLIR_COMPUTE_POOL_H
@@ -28,6 +28,8 @@
 
 
 #include "model_instance_state.h"
+#include "backend_state.h"
+#include "numa.h"
 #include "triton/core/tritonbackend.h"
 
 namespace triton { namespace backend { namespace onnxmlir {
@@ -46,10 +48,98 @@ ModelInstanceState::Create(
         std::string("unexpected nullptr in BackendModelInstanceException"));
     RETURN_IF_ERROR(ex.err_);
   }
+  TRITONSERVER_Error* err = (*state)->SetupNuma();
+  if(err != nullptr){
+    delete *state;
+    *state = nullptr;
+    return err;
+  }
 
   return nullptr;  // success
 }
 
+ModelInstanceState::~ModelInstanceState(){
+  if(numa_node_ < 0)
+    return;
+  LOG_MESSAGE(TRITONSERVER_LOG_INFO,
+      ("onnxmlir: instance " + Name() + " placed " + std::to_string(numa_local_bytes_) +
+       " bytes on NUMA node " + std::to_string(numa_node_) +
+       (bound_thread_ == std::thread::id() || thread_bound_ ? "" : ", its thread could not be bound to the node")).c_str());
+  if(numa_local_bytes_metric_)
+    LOG_IF_ERROR(TRITONSERVER_MetricDelete(numa_local_bytes_metric_), "failed to delete metric");
+}
+
+TRITONSERVER_Error* ModelInstanceState::HostPolicyNumaNode(int *node){
+  *node = -1;
+  TRITONSERVER_Message* message;
+  RETURN_IF_ERROR(TRITONBACKEND_ModelInstanceHostPolicy(TritonModelInstance(), &message));
+  const char* buffer;
+  size_t byte_size;
+  RETURN_IF_ERROR(TRITONSERVER_MessageSerializeToJson(message, &buffer, &byte_size));
+  common::TritonJson::Value host_policy;
+  common::TritonJson::Value policy;
+  if(byte_size == 0)
+    return nullptr;
+  RETURN_IF_ERROR(host_policy.Parse(buffer, byte_size));
+  if(!host_policy.Find(HostPolicyName().c_str(), &policy) || !policy.Find("numa-node"))
+    return nullptr;
+  std::string value;
+  RETURN_IF_ERROR(policy.MemberAsString("numa-node", &value));
+  return ParseIntValue(value, node);
+}
+
+TRITONSERVER_Error* ModelInstanceState::SetupNuma(){
+  int node;
+  RETURN_IF_ERROR(HostPolicyNumaNode(&node));
+  if(node < 0)
+    node = model_state_->NextNumaNode();
+  if(node < 0)
+    return nullptr;
+  std::vector<int> cpus;
+  RETURN_IF_ERROR(NumaNodeCpus(node, &cpus));
+  numa_node_ = node;
+  for(AlignedBuffer& buffer : input_buffers_)
+    buffer.SetNumaNode(numa_node_);
+  for(AlignedBuffer& buffer : output_buffers_)
+    buffer.SetNumaNode(numa_node_);
+
+  TRITONSERVER_MetricFamily* family = model_state_->Backend()->NumaLocalBytesFamily();
+  if(family != nullptr){
+    std::string version = std::to_string(model_state_->Version());
+    std::string node_label = std::to_string(numa_node_);
+    const TRITONSERVER_Parameter* labels[] = {
+        TRITONSERVER_ParameterNew("model", TRITONSERVER_PARAMETER_STRING, model_state_->Name().c_str()),
+        TRITONSERVER_ParameterNew("version", TRITONSERVER_PARAMETER_STRING, version.c_str()),
+        TRITONSERVER_ParameterNew("numa_node", TRITONSERVER_PARAMETER_STRING, node_label.c_str())};
+    LOG_IF_ERROR(TRITONSERVER_MetricNew(&numa_local_bytes_metric_, family, labels, 3),
+                 "failed to create NUMA metric");
+    for(const TRITONSERVER_Parameter* label : labels)
+      TRITONSERVER_ParameterDelete(const_cast<TRITONSERVER_Parameter*>(label));
+  }
+  LOG_MESSAGE(TRITONSERVER_LOG_INFO,
+      ("onnxmlir: instance " + Name() + " bound to NUMA node " + std::to_string(numa_node_)).c_str());
+  return nullptr;
+}
+
+void ModelInstanceState::BindThread(){
+  if(bound_thread_ == std::this_thread::get_id())
+    return;
+  // only tried once per thread, a failure is not worth a log per batch
+  bound_thread_ = std::this_thread::get_id();
+  TRITONSERVER_Error *err = BindThreadToNumaNode(numa_node_);
+  thread_bound_ = err == nullptr;
+  LOG_IF_ERROR(err, "failed to bind instance thread");
+}
+
+void ModelInstanceState::AddNumaLocalBytes(uint64_t bytes){
+  if(numa_node_ < 0 || bytes == 0)
+    return;
+  numa_local_bytes_ += bytes;
+  if(numa_local_bytes_metric_)
+    LOG_IF_ERROR(TRITONSERVER_MetricIncrement(numa_local_bytes_metric_, bytes),
+                 "failed to increment NUMA metric");
+}
+
 
 extern "C" {
 
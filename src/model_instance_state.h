@@ -31,8 +31,12 @@
 #define ONNX_MLIR_MODEL_INSTANCE_STATE_H
 
 #include "triton/backend/backend_model_instance.h"
+#include "aligned_buffer.h"
 #include "model_state.h"
 
+#include <thread>
+#include <vector>
+
 #include <OnnxMlirRuntime.h>
 
 namespace triton { namespace backend { namespace onnxmlir {
@@ -52,18 +56,45 @@ class ModelInstanceState : public BackendModelInstance {
       ModelState* model_state,
       TRITONBACKEND_ModelInstance* triton_model_instance,
       ModelInstanceState** state);
-  virtual ~ModelInstanceState() = default;
+  virtual ~ModelInstanceState();
 
   // Get the state of the model that corresponds to this instance.
   ModelState* StateForModel() const { return model_state_; }
 
+  // Buffer the batch of input 'index' is gathered into, reused across
+  // executions of this instance.
+  AlignedBuffer* InputBuffer(size_t index) { return &input_buffers_[index]; }
+  // Buffer output 'index' is quantized into, only used for quantized
+  // outputs.
+  AlignedBuffer* OutputBuffer(size_t index) { return &output_buffers_[index]; }
+
+  // NUMA node the instance is bound to, -1 if none. From the numa-node
+  // of the instance's host policy or else the model's 'numa_nodes'.
+  int NumaNode() const { return numa_node_; }
+  // Bind the calling thread to the NUMA node, once per thread.
+  void BindThread();
+  // Count 'bytes' of buffers bound to the NUMA node for the metrics.
+  void AddNumaLocalBytes(uint64_t bytes);
+
  private:
   ModelInstanceState(
       ModelState* model_state,
       TRITONBACKEND_ModelInstance* triton_model_instance)
       : BackendModelInstance(model_state, triton_model_instance),
-        model_state_(model_state) { }
+        model_state_(model_state),
+        input_buffers_(model_state->input_tensors.size()),
+        output_buffers_(model_state->output_tensors.size()) { }
+  TRITONSERVER_Error* SetupNuma();
+  TRITONSERVER_Error* HostPolicyNumaNode(int *node);
   ModelState* model_state_;
+  std::vector<AlignedBuffer> input_buffers_;
+  std::vector<AlignedBuffer> output_buffers_;
+  int numa_node_ = -1;
+  std::thread::id bound_thread_;
+  // whether binding bound_thread_ succeeded
+  bool thread_bound_ = false;
+  uint64_t numa_local_bytes_ = 0;
+  TRITONSERVER_Metric* numa_local_bytes_metric_ = nullptr;
 };
 
 }}}  // namespace triton::backend::onnxmlir
@@ -0,0 +1,422 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#include "model_library.h"
+
+#include "onnxmlir_trace.h"
+#include "triton/backend/backend_common.h"
+
+#include <dirent.h>
+#include <dlfcn.h>
+#include <fcntl.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+namespace {
+
+uint64_t NowNs(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace
+
+namespace {
+
+const char CONSTANTS_SUFFIX[] = ".constants.bin";
+
+// One FNV-1a step over a 64 bit word with an extra shift to mix the
+// high bits down.
+uint64_t Mix(uint64_t h, uint64_t word){
+  h = (h ^ word) * 0x100000001b3ULL;
+  return h ^ (h >> 29);
+}
+
+std::string BaseName(const std::string &path){
+  size_t slash = path.rfind('/');
+  return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+// The files dlopen'ing 'path' reads: the library itself, then the
+// constants onnx-mlir stores next to it with --store-constants-to-file
+// (<name>.constants.bin), sorted by name.
+std::vector<std::string> ModelFiles(const std::string &path){
+  std::vector<std::string> files(1, path);
+  size_t slash = path.rfind('/');
+  std::string dir = slash == std::string::npos ? "." : path.substr(0, slash);
+  DIR *d = opendir(dir.c_str());
+  if(d == nullptr)
+    return files;
+  const size_t suffix_length = sizeof(CONSTANTS_SUFFIX) - 1;
+  std::vector<std::string> constants;
+  while(struct dirent *entry = readdir(d)){
+    std::string name = entry->d_name;
+    if(name.size() > suffix_length &&
+       name.compare(name.size() - suffix_length, suffix_length, CONSTANTS_SUFFIX) == 0)
+      constants.push_back(dir + "/" + name);
+  }
+  closedir(d);
+  std::sort(constants.begin(), constants.end());
+  files.insert(files.end(), constants.begin(), constants.end());
+  return files;
+}
+
+// Hash the content of 'path' into 'h' and add its size to 'total_size'.
+TRITONSERVER_Error* HashOneFile(const std::string &path, uint64_t *h, uint64_t *total_size){
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  RETURN_ERROR_IF_TRUE(fd == -1, TRITONSERVER_ERROR_UNAVAILABLE,
+      "failed to open " + path + ": " + strerror(errno));
+  struct stat st;
+  if(fstat(fd, &st) != 0){
+    close(fd);
+    return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_UNAVAILABLE,
+        ("failed to stat " + path + ": " + strerror(errno)).c_str());
+  }
+  uint64_t size = st.st_size;
+  // the size is mixed in first so the zero padded tail can not collide
+  // with a longer file
+  *h = Mix(*h, size);
+  if(size > 0){
+    void *data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(data == MAP_FAILED){
+      close(fd);
+      return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_UNAVAILABLE,
+          ("failed to map " + path + ": " + strerror(errno)).c_str());
+    }
+    madvise(data, size, MADV_SEQUENTIAL);
+    const unsigned char *bytes = (const unsigned char*)data;
+    uint64_t i = 0;
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)){
+      uint64_t word;
+      memcpy(&word, bytes + i, sizeof(word));
+      *h = Mix(*h, word);
+    }
+    uint64_t tail = 0;
+    memcpy(&tail, bytes + i, size - i);
+    *h = Mix(*h, tail);
+    munmap(data, size);
+  }
+  close(fd);
+  *total_size += size;
+  return nullptr;
+}
+
+bool SameFileContent(const std::string &a, const std::string &b){
+  std::ifstream file_a(a, std::ios::binary), file_b(b, std::ios::binary);
+  if(!file_a || !file_b)
+    return false;
+  std::vector<char> buffer_a(1 << 20), buffer_b(1 << 20);
+  while(true){
+    file_a.read(buffer_a.data(), buffer_a.size());
+    file_b.read(buffer_b.data(), buffer_b.size());
+    if(file_a.gcount() != file_b.gcount() ||
+       memcmp(buffer_a.data(), buffer_b.data(), file_a.gcount()) != 0)
+      return false;
+    if(file_a.gcount() == 0 || file_a.eof() || file_b.eof())
+      return file_a.eof() && file_b.eof();
+  }
+}
+
+// Whether the libraries at 'a' and 'b' and the constants they read are
+// byte identical, confirming a hash match before sharing a library.
+bool SameModelFiles(const std::string &a, const std::string &b){
+  std::vector<std::string> files_a = ModelFiles(a), files_b = ModelFiles(b);
+  if(files_a.size() != files_b.size())
+    return false;
+  for(size_t i = 0; i < files_a.size(); i++){
+    if(i > 0 && BaseName(files_a[i]) != BaseName(files_b[i]))
+      return false;
+    if(!SameFileContent(files_a[i], files_b[i]))
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+TRITONSERVER_Error* HashModelFiles(const std::string &path, uint64_t *hash, uint64_t *total_size){
+  uint64_t h = 0xcbf29ce484222325ULL;
+  uint64_t size = 0;
+  for(const std::string &file : ModelFiles(path)){
+    // the names of the constants are part of the key, the runtime
+    // looks them up by name
+    if(file != path){
+      for(char c : BaseName(file))
+        h = Mix(h, (unsigned char)c);
+    }
+    RETURN_IF_ERROR(HashOneFile(file, &h, &size));
+  }
+  *hash = h;
+  *total_size = size;
+  return nullptr;
+}
+
+ModelLibrary::~ModelLibrary(){
+  if(handle_)
+    dlclose(handle_);
+}
+
+#define RETURN_DLERROR_IF_NULL(x) RETURN_ERROR_IF_FALSE(x, TRITONSERVER_ERROR_UNAVAILABLE, std::string(dlerror()))
+
+TRITONSERVER_Error* ModelLibrary::Load(bool prefetch){
+  LOG_VERBOSE(("Loading " + path_).c_str());
+  handle_ = dlopen(path_.c_str(), RTLD_LAZY);
+  RETURN_ERROR_IF_FALSE(handle_, TRITONSERVER_ERROR_UNAVAILABLE, std::string("failed to load ") + path_ + ": " + dlerror());
+  if(prefetch)
+    Prefetch();
+  dll_omQueryEntryPoints = (const char* const* (*)(int64_t*)) dlsym(handle_, "omQueryEntryPoints");
+  RETURN_DLERROR_IF_NULL(dll_omQueryEntryPoints);
+  dll_omInputSignature = (const char* (*)(const char *)) dlsym(handle_, "omInputSignature");
+  RETURN_DLERROR_IF_NULL(dll_omInputSignature);
+  dll_omOutputSignature = (const char* (*)(const char *)) dlsym(handle_, "omOutputSignature");
+  RETURN_DLERROR_IF_NULL(dll_omOutputSignature);
+  dll_run_main_graph = (OMTensorList * (*)(OMTensorList *)) dlsym(handle_, "run_main_graph");
+  RETURN_DLERROR_IF_NULL(dll_run_main_graph);
+  dll_omTensorCreate = (OMTensor * (*)(void *, int64_t *, int64_t, OM_DATA_TYPE)) dlsym(handle_, "omTensorCreate");
+  RETURN_DLERROR_IF_NULL(dll_omTensorCreate);
+  dll_omTensorListCreate = (OMTensorList * (*)(OMTensor **, int)) dlsym(handle_, "omTensorListCreate");
+  RETURN_DLERROR_IF_NULL(dll_omTensorListCreate);
+  dll_omTensorListGetOmtByIndex = (OMTensor * (*)(OMTensorList *, int64_t)) dlsym(handle_, "omTensorListGetOmtByIndex");
+  RETURN_DLERROR_IF_NULL(dll_omTensorListGetOmtByIndex);
+  dll_omTensorGetDataPtr = (void* (*)(OMTensor *))dlsym(handle_, "omTensorGetDataPtr");
+  RETURN_DLERROR_IF_NULL( dll_omTensorGetDataPtr);
+  dll_omTensorGetRank = (int64_t (*)(OMTensor *))dlsym(handle_, "omTensorGetRank");
+  RETURN_DLERROR_IF_NULL( dll_omTensorGetRank);
+  dll_omTensorGetShape = (int64_t* (*)(OMTensor *))dlsym(handle_, "omTensorGetShape");
+  RETURN_DLERROR_IF_NULL( dll_omTensorGetShape);
+  dll_omTensorGetDataType = (OM_DATA_TYPE (*)(OMTensor *))dlsym(handle_, "omTensorGetDataType");
+  RETURN_DLERROR_IF_NULL( dll_omTensorGetDataType);
+  dll_omTensorListGetSize = (int64_t (*)(OMTensorList *))dlsym(handle_, "omTensorListGetSize");
+  RETURN_DLERROR_IF_NULL(dll_omTensorListGetSize);
+  dll_omTensorListDestroy = (void (*)(OMTensorList *))dlsym(handle_, "omTensorListDestroy");
+  RETURN_DLERROR_IF_NULL(dll_omTensorListDestroy);
+  dll_omTensorDestroy = (void (*)(OMTensor *))dlsym(handle_, "omTensorDestroy");
+  RETURN_DLERROR_IF_NULL(dll_omTensorDestroy);
+  return nullptr;
+}
+
+namespace {
+
+int PrefetchSegments(struct dl_phdr_info *info, size_t size, void *data){
+  const struct link_map *map = (const struct link_map*)data;
+  if(info->dlpi_addr != map->l_addr || strcmp(info->dlpi_name, map->l_name))
+    return 0;
+  const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+  for(int i = 0; i < info->dlpi_phnum; i++){
+    const ElfW(Phdr) &phdr = info->dlpi_phdr[i];
+    // read-only segments hold the code and the constants (weights)
+    if(phdr.p_type != PT_LOAD || (phdr.p_flags & PF_W))
+      continue;
+    uintptr_t start = (info->dlpi_addr + phdr.p_vaddr) & ~(page_size - 1);
+    uintptr_t end = info->dlpi_addr + phdr.p_vaddr + phdr.p_memsz;
+    madvise((void*)start, end - start, MADV_WILLNEED);
+  }
+  return 1;
+}
+
+}  // namespace
+
+// Ask the kernel to read the read-only segments of the library ahead,
+// so the first inference does not page in the weights one fault at a
+// time.
+void ModelLibrary::Prefetch(){
+  struct link_map *map;
+  if(dlinfo(handle_, RTLD_DI_LINKMAP, &map) != 0)
+    return;
+  dl_iterate_phdr(PrefetchSegments, map);
+}
+
+TRITONSERVER_Error* ModelLibraryRegistry::Acquire(const std::string &path, ModelLibrary **library){
+  uint64_t hash = 0, file_size = 0;
+  if(share_libraries_)
+    RETURN_IF_ERROR(HashModelFiles(path, &hash, &file_size));
+  std::lock_guard<std::mutex> lock(mutex_);
+  Key key(hash, file_size);
+  bool register_library = share_libraries_;
+  if(share_libraries_){
+    auto pos = libraries_.find(key);
+    if(pos != libraries_.end()){
+      // A hash match alone could hand out another model's weights.
+      if(SameModelFiles(pos->second->Path(), path)){
+        LOG_VERBOSE(("Sharing " + pos->second->Path() + " for identical " + path).c_str());
+        pos->second->ref_count_++;
+        *library = pos->second;
+        return nullptr;
+      }
+      LOG_MESSAGE(TRITONSERVER_LOG_WARN,
+          ("Hash of " + path + " collides with " + pos->second->Path() +
+           ", loading it unshared").c_str());
+      register_library = false;
+    }
+  }
+  ModelLibrary *lib = new ModelLibrary(path, hash, file_size);
+  TRITONSERVER_Error *err = lib->Load(prefetch_);
+  if(err != nullptr){
+    delete lib;
+    return err;
+  }
+  lib->ref_count_ = 1;
+  loaded_bytes_ += lib->file_size_;
+  if(register_library)
+    libraries_[key] = lib;
+  *library = lib;
+  return nullptr;
+}
+
+void ModelLibraryRegistry::Release(ModelLibrary *library){
+  std::lock_guard<std::mutex> lock(mutex_);
+  ReleaseLocked(library);
+}
+
+void ModelLibraryRegistry::ReleaseLocked(ModelLibrary *library){
+  if(--library->ref_count_ > 0)
+    return;
+  if(share_libraries_){
+    auto pos = libraries_.find(Key(library->hash_, library->file_size_));
+    if(pos != libraries_.end() && pos->second == library)
+      libraries_.erase(pos);
+  }
+  loaded_bytes_ -= library->file_size_;
+  delete library;
+}
+
+ModelLibraryRegistry::~ModelLibraryRegistry(){
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  unload_cv_.notify_all();
+  if(unload_thread_.joinable())
+    unload_thread_.join();
+}
+
+void ModelLibraryRegistry::Register(LazyModelLibrary *lazy){
+  std::lock_guard<std::mutex> lock(mutex_);
+  lazy_libraries_.insert(lazy);
+  if(!unload_thread_.joinable())
+    unload_thread_ = std::thread(&ModelLibraryRegistry::UnloadIdleLibraries, this);
+}
+
+void ModelLibraryRegistry::Unregister(LazyModelLibrary *lazy){
+  std::lock_guard<std::mutex> lock(mutex_);
+  lazy_libraries_.erase(lazy);
+}
+
+void ModelLibraryRegistry::EnforceBudget(){
+  if(memory_budget_ == 0)
+    return;
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t now = NowNs();
+  while(loaded_bytes_ > memory_budget_){
+    // Lazy libraries that are busy (try_lock fails) or pinned are
+    // skipped, so this never waits for an execution. So are libraries
+    // another model or a shadow still references: only dropping the
+    // last reference frees memory, evicting any other would just make
+    // the model reload and rehash it on its next execute.
+    LazyModelLibrary *victim = nullptr;
+    std::unique_lock<std::mutex> victim_lock;
+    for(LazyModelLibrary *lazy : lazy_libraries_){
+      std::unique_lock<std::mutex> lazy_lock(lazy->mutex_, std::try_to_lock);
+      if(!lazy_lock.owns_lock() || !lazy->Evictable(now, false) ||
+         lazy->library_->ref_count_ > 1)
+        continue;
+      if(victim == nullptr || lazy->last_used_ns_ < victim->last_used_ns_){
+        victim = lazy;
+        victim_lock = std::move(lazy_lock);
+      }
+    }
+    if(victim == nullptr){
+      LOG_VERBOSE(("onnxmlir: model libraries use " + std::to_string(loaded_bytes_) +
+           " bytes, over the budget of " + std::to_string(memory_budget_) +
+           " but nothing can be unloaded").c_str());
+      return;
+    }
+    LOG_VERBOSE(("Unloading least recently used " + victim->path_ + " to meet the memory budget").c_str());
+    victim->EvictLocked();
+  }
+}
+
+void ModelLibraryRegistry::UnloadIdleLibraries(){
+  std::unique_lock<std::mutex> lock(mutex_);
+  while(!stop_){
+    unload_cv_.wait_for(lock, std::chrono::seconds(1));
+    uint64_t now = NowNs();
+    for(LazyModelLibrary *lazy : lazy_libraries_){
+      std::unique_lock<std::mutex> lazy_lock(lazy->mutex_, std::try_to_lock);
+      if(!lazy_lock.owns_lock() || !lazy->Evictable(now, true))
+        continue;
+      LOG_VERBOSE(("Unloading idle " + lazy->path_).c_str());
+      lazy->EvictLocked();
+    }
+  }
+}
+
+LazyModelLibrary::LazyModelLibrary(
+    ModelLibraryRegistry *registry, const std::string &path,
+    uint64_t expected_hash, uint64_t idle_timeout_ns)
+    : registry_(registry), path_(path), expected_hash_(expected_hash),
+      idle_timeout_ns_(idle_timeout_ns){
+  registry_->Register(this);
+}
+
+LazyModelLibrary::~LazyModelLibrary(){
+  registry_->Unregister(this);
+  std::lock_guard<std::mutex> lock(mutex_);
+  if(library_)
+    registry_->Release(library_);
+}
+
+TRITONSERVER_Error* LazyModelLibrary::Pin(ModelLibrary **library){
+  bool loaded = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if(!library_){
+      ModelLibrary *lib;
+      RETURN_IF_ERROR(registry_->Acquire(path_, &lib));
+      // the signatures were only validated for the library seen at
+      // model load, refuse a model.so replaced since then
+      if(expected_hash_ != 0 && lib->ContentHash() != expected_hash_){
+        registry_->Release(lib);
+        return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_UNAVAILABLE,
+            (path_ + " changed since the model was loaded, reload the model").c_str());
+      }
+      library_ = lib;
+      loaded = true;
+    }
+    pins_++;
+    *library = library_;
+  }
+  if(loaded)
+    registry_->EnforceBudget();
+  return nullptr;
+}
+
+void LazyModelLibrary::Unpin(){
+  std::lock_guard<std::mutex> lock(mutex_);
+  pins_--;
+  last_used_ns_ = NowNs();
+}
+
+bool LazyModelLibrary::Evictable(uint64_t now_ns, bool idle_only) const {
+  if(!library_ || pins_ > 0)
+    return false;
+  if(!idle_only)
+    return true;
+  return idle_timeout_ns_ != 0 && now_ns - last_used_ns_ >= idle_timeout_ns_;
+}
+
+void LazyModelLibrary::EvictLocked(){
+  registry_->ReleaseLocked(library_);
+  library_ = nullptr;
+}
+
+}}}  // namespace triton::backend::onnxmlir
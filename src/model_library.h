@@ -0,0 +1,165 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#ifndef ONNX_MLIR_MODEL_LIBRARY_H
+#define ONNX_MLIR_MODEL_LIBRARY_H
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include "triton/core/tritonserver.h"
+
+#include <OnnxMlirRuntime.h>
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+class LazyModelLibrary;
+
+//
+// ModelLibrary
+//
+// A dlopen'ed model.so together with the resolved onnx-mlir runtime
+// entry points. Libraries are handed out by the ModelLibraryRegistry,
+// which shares one ModelLibrary between all models and versions whose
+// model.so and constants files have identical content.
+//
+class ModelLibrary {
+ public:
+  const std::string& Path() const { return path_; }
+  // Hash and total size of model.so and its constants files.
+  uint64_t ContentHash() const { return hash_; }
+  uint64_t FileSize() const { return file_size_; }
+
+  const char* const* (*dll_omQueryEntryPoints)(int64_t*);
+  const char* (*dll_omInputSignature)(const char *);
+  const char* (*dll_omOutputSignature)(const char *);
+  OMTensorList* (*dll_run_main_graph)(OMTensorList *);
+  OMTensor* (*dll_omTensorCreate)(void *, int64_t *, int64_t, OM_DATA_TYPE);
+  OMTensorList *(*dll_omTensorListCreate)(OMTensor **, int);
+  OMTensor* (*dll_omTensorListGetOmtByIndex)(OMTensorList *, int64_t);
+  void* (*dll_omTensorGetDataPtr)(OMTensor *);
+  int64_t (*dll_omTensorGetRank)(OMTensor *);
+  int64_t* (*dll_omTensorGetShape)(OMTensor *);
+  OM_DATA_TYPE (*dll_omTensorGetDataType)(OMTensor *);
+  void (*dll_omTensorDestroy)(OMTensor *tensor);
+  int64_t (*dll_omTensorListGetSize)(OMTensorList *);
+  void (*dll_omTensorListDestroy)(OMTensorList *);
+
+ protected:
+  // Protected so benchmarks can provide the entry points without a
+  // model.so, all other libraries come from the registry.
+  ModelLibrary(const std::string &path, uint64_t hash, uint64_t file_size)
+      : path_(path), hash_(hash), file_size_(file_size) {}
+  ~ModelLibrary();
+
+ private:
+  friend class ModelLibraryRegistry;
+  TRITONSERVER_Error* Load(bool prefetch);
+  void Prefetch();
+
+  std::string path_;
+  uint64_t hash_;
+  uint64_t file_size_;
+  void *handle_ = nullptr;
+  int ref_count_ = 0;
+};
+
+//
+// ModelLibraryRegistry
+//
+// Backend wide registry of loaded model libraries, keyed by content
+// hash and size of the model.so and the *.constants.bin files next to
+// it. Byte identical libraries (A/B copies, unchanged versions) are only
+// loaded once, so weights embedded in the library are mapped and
+// relocated once instead of once per model. A hash match is confirmed
+// by comparing the files before a library is shared.
+//
+// The registry also tracks the libraries of lazily loaded models
+// (LazyModelLibrary): those are unloaded by a background thread once
+// they have been idle for their timeout, and least recently used first
+// whenever the loaded libraries exceed 'memory_budget' bytes (0 means
+// no budget).
+//
+class ModelLibraryRegistry {
+ public:
+  ModelLibraryRegistry(bool share_libraries, bool prefetch, uint64_t memory_budget)
+      : share_libraries_(share_libraries), prefetch_(prefetch),
+        memory_budget_(memory_budget) {}
+  ~ModelLibraryRegistry();
+  // Load 'path' or take a reference on an already loaded library with
+  // the same content.
+  TRITONSERVER_Error* Acquire(const std::string &path, ModelLibrary **library);
+  // Drop a reference, the library is unloaded with its last reference.
+  void Release(ModelLibrary *library);
+  // Whether libraries are shared, only then they are hashed.
+  bool SharesLibraries() const { return share_libraries_; }
+
+ private:
+  friend class LazyModelLibrary;
+  typedef std::pair<uint64_t, uint64_t> Key;
+  void ReleaseLocked(ModelLibrary *library);
+  void Register(LazyModelLibrary *lazy);
+  void Unregister(LazyModelLibrary *lazy);
+  // Unload idle lazy libraries until the budget is met.
+  void EnforceBudget();
+  // Body of the thread unloading idle lazy libraries.
+  void UnloadIdleLibraries();
+
+  bool share_libraries_;
+  bool prefetch_;
+  uint64_t memory_budget_;
+  uint64_t loaded_bytes_ = 0;
+  std::mutex mutex_;
+  std::map<Key, ModelLibrary*> libraries_;
+  std::set<LazyModelLibrary*> lazy_libraries_;
+  std::thread unload_thread_;
+  std::condition_variable unload_cv_;
+  bool stop_ = false;
+};
+
+//
+// LazyModelLibrary
+//
+// Model library that is loaded on first use instead of at model load
+// and that the registry may unload again when it is idle or memory is
+// short. An execution pins the library to keep it loaded while it runs.
+//
+class LazyModelLibrary {
+ public:
+  // 'expected_hash' is the content hash of the library validated at
+  // model load, 0 if unknown. 'idle_timeout_ns' 0 keeps the library
+  // loaded once it was used, unless the memory budget is exceeded.
+  LazyModelLibrary(ModelLibraryRegistry *registry, const std::string &path,
+                   uint64_t expected_hash, uint64_t idle_timeout_ns);
+  ~LazyModelLibrary();
+  // Load the library if needed and keep it loaded until Unpin().
+  TRITONSERVER_Error* Pin(ModelLibrary **library);
+  void Unpin();
+
+ private:
+  friend class ModelLibraryRegistry;
+  // Called with the registry and the own mutex held.
+  bool Evictable(uint64_t now_ns, bool idle_only) const;
+  void EvictLocked();
+
+  ModelLibraryRegistry *registry_;
+  std::string path_;
+  uint64_t expected_hash_;
+  uint64_t idle_timeout_ns_;
+  std::mutex mutex_;
+  ModelLibrary *library_ = nullptr;
+  int pins_ = 0;
+  uint64_t last_used_ns_ = 0;
+};
+
+// 64 bit content hash and total size of the model library at 'path'
+// and the constants files onnx-mlir stores next to it, the key of
+// shared libraries and validated signatures.
+TRITONSERVER_Error* HashModelFiles(const std::string &path, uint64_t *hash, uint64_t *total_size);
+
+}}}  // namespace triton::backend::onnxmlir
+
+#endif //ONNX_MLIR_MODEL_LIBRARY_H
@@ -27,12 +27,16 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "model_state.h"
+#include "backend_state.h"
+#include "numa.h"
+#include "onnxmlir_trace.h"
 #include "onnxmlir_typemapping.h"
+#include "quantization.h"
 #include "triton/core/tritonbackend.h"
 
 #include "rapidjson/document.h"
 
-#include <dlfcn.h>
+#include <cmath>
 
 namespace triton { namespace backend { namespace onnxmlir {
 
@@ -41,8 +45,9 @@ TensorDef::TensorDef(triton::common::TritonJson::Value &tensor, bool supports_fi
     std::string member;
     THROW_IF_BACKEND_MODEL_ERROR(tensor.MemberAsString("data_type", &member));
     triton_dtype = ModelConfigDataTypeToTritonServerDataType(member);
-    dtype_size = TRITONSERVER_DataTypeByteSize(triton_dtype);
+    dtype_size = TritonDataTypeByteSize(triton_dtype);
     om_dtype = TritonDataTypeToOmDataType(triton_dtype);
+    om_dtype_size = dtype_size;
     if(om_dtype == ONNX_TYPE_UNDEFINED)
       throw triton::backend::BackendModelException(TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_UNSUPPORTED, ("No ONNX MLIR datatype for " + member).c_str()));
     triton::common::TritonJson::Value reshape;
@@ -56,22 +61,24 @@ TensorDef::TensorDef(triton::common::TritonJson::Value &tensor, bool supports_fi
       size *= shape[i];
     }
     byte_size = size * dtype_size;
+    batched = supports_first_dim_batching;
     if(supports_first_dim_batching)
       shape.insert(shape.begin(), -1);
 }
 
-bool TensorDef::CheckTensorMatches(ModelState *model_state, OMTensor *tensor, std::string &error){
-  OM_DATA_TYPE tensor_dt = model_state->dll_omTensorGetDataType(tensor);
+bool TensorDef::CheckTensorMatches(const ModelLibrary *library, OMTensor *tensor, std::string &error){
+  OM_DATA_TYPE tensor_dt = library->dll_omTensorGetDataType(tensor);
   if(tensor_dt != om_dtype){
     error = "datatype missmatches config";
+    return false;
   }
   int64_t tensor_dims = shape.size();
-  if(tensor_dims != model_state->dll_omTensorGetRank(tensor)){
+  if(tensor_dims != library->dll_omTensorGetRank(tensor)){
     error = "number of dimensions missmatches config: " + std::to_string(shape.size()) + " actual: " + std::to_string(tensor_dims);
     return false;
   }
-  int64_t *tensor_shape = model_state->dll_omTensorGetShape(tensor);
-  for(int64_t s = model_state->supports_first_dim_batching ? 1:0; s < tensor_dims; s++){
+  int64_t *tensor_shape = library->dll_omTensorGetShape(tensor);
+  for(int64_t s = batched ? 1:0; s < tensor_dims; s++){
     if(shape[s] != -1 && tensor_shape[s] != shape[s]){
       std::string shape_str;
       IGNORE_ERROR(BufferAsTypedString(shape_str, (const char*)tensor_shape, tensor_dims * sizeof(int64_t), TRITONSERVER_TYPE_INT64));
@@ -82,41 +89,150 @@ bool TensorDef::CheckTensorMatches(ModelState *model_state, OMTensor *tensor, st
   return true;
 }
 
-bool TensorDef::CheckSignature(const rapidjson::Value &signature, std::string &error){
-  if(signature["name"].GetString() != name){
-    error = "name";
+bool TensorDef::CheckSignature(const rapidjson::Value &signature, std::string &error) const {
+  // FindMember instead of operator[], which asserts on missing members
+  rapidjson::Value::ConstMemberIterator member = signature.FindMember("type");
+  if(member == signature.MemberEnd() || !member->value.IsString()){
+    error = "type of '" + name + "' missing";
     return false;
   }
-  OM_DATA_TYPE type = MlirDataTypeToOmDataType(signature["type"].GetString());
+  OM_DATA_TYPE type = MlirDataTypeToOmDataType(
+      member->value.GetString(), member->value.GetStringLength());
   if(om_dtype != type){
-    error = "type";
+    error = "type of '" + name + "'";
+    return false;
+  }
+  member = signature.FindMember("dims");
+  if(member == signature.MemberEnd() || !member->value.IsArray()){
+    error = "dims of '" + name + "' missing";
     return false;
   }
-  const rapidjson::Value& dims = signature["dims"];
+  const rapidjson::Value& dims = member->value;
   if(dims.Size() != shape.size()){
-    error = "rank";
+    error = "rank of '" + name + "'";
     return false;
   }
   for(rapidjson::SizeType j = 0; j < dims.Size(); j++){
+    if(!dims[j].IsInt64()){
+      error = "dims of '" + name + "' not integers";
+      return false;
+    }
     int64_t model_dim = dims[j].GetInt64();
     if(model_dim != -1 && model_dim != shape[j]){
-      error = "shape";
+      error = "shape of '" + name + "'";
       return false;
     }
   }
   return true;
 }
 
+TRITONSERVER_Error* TensorDef::SetQuantization(const std::string &spec){
+  RETURN_ERROR_IF_FALSE(
+      triton_dtype == TRITONSERVER_TYPE_INT8 || triton_dtype == TRITONSERVER_TYPE_UINT8,
+      TRITONSERVER_ERROR_INVALID_ARG,
+      "quantized tensor '" + name + "' must have data_type TYPE_INT8 or TYPE_UINT8");
+  double parsed_scale = 0;
+  int parsed_zero_point = 0;
+  bool has_scale = false;
+  size_t begin = 0;
+  while(begin <= spec.size()){
+    size_t end = spec.find(',', begin);
+    if(end == std::string::npos)
+      end = spec.size();
+    std::string item = spec.substr(begin, end - begin);
+    size_t eq = item.find('=');
+    RETURN_ERROR_IF_TRUE(eq == std::string::npos, TRITONSERVER_ERROR_INVALID_ARG,
+        "expected <key>=<value> in quantization of '" + name + "', got '" + item + "'");
+    std::string key = item.substr(0, eq);
+    std::string value = item.substr(eq + 1);
+    if(key == "scale"){
+      RETURN_IF_ERROR(ParseDoubleValue(value, &parsed_scale));
+      has_scale = true;
+    } else if(key == "zero_point"){
+      RETURN_IF_ERROR(ParseIntValue(value, &parsed_zero_point));
+    } else {
+      return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG,
+          ("unknown key '" + key + "' in quantization of '" + name + "'").c_str());
+    }
+    begin = end + 1;
+  }
+  RETURN_ERROR_IF_FALSE(has_scale && std::isfinite(parsed_scale) && parsed_scale > 0,
+      TRITONSERVER_ERROR_INVALID_ARG,
+      "quantization of '" + name + "' needs a positive scale");
+  const int min_zero_point = triton_dtype == TRITONSERVER_TYPE_INT8 ? -128 : 0;
+  const int max_zero_point = triton_dtype == TRITONSERVER_TYPE_INT8 ? 127 : 255;
+  RETURN_ERROR_IF_FALSE(
+      parsed_zero_point >= min_zero_point && parsed_zero_point <= max_zero_point,
+      TRITONSERVER_ERROR_INVALID_ARG,
+      "zero_point of '" + name + "' out of range of its data_type");
+  quantized = true;
+  scale = parsed_scale;
+  zero_point = parsed_zero_point;
+  om_dtype = ONNX_TYPE_FLOAT;
+  om_dtype_size = sizeof(float);
+  return nullptr;
+}
+
+void TensorDef::Dequantize(const char *wire, char *model, size_t count) const {
+  if(triton_dtype == TRITONSERVER_TYPE_INT8)
+    onnxmlir::Dequantize((const int8_t*)wire, (float*)model, count, scale, zero_point);
+  else
+    onnxmlir::Dequantize((const uint8_t*)wire, (float*)model, count, scale, zero_point);
+}
+
+void TensorDef::Quantize(const char *model, char *wire, size_t count) const {
+  if(triton_dtype == TRITONSERVER_TYPE_INT8)
+    onnxmlir::Quantize((const float*)model, (int8_t*)wire, count, scale, zero_point);
+  else
+    onnxmlir::Quantize((const float*)model, (uint8_t*)wire, count, scale, zero_point);
+}
+
+int64_t TensorDef::BatchSize(const int64_t *shape, uint32_t dims_count, size_t byte_size) const {
+  size_t features_size = dtype_size;
+  for(uint32_t d = 1; d < dims_count; d++){
+    features_size *= shape[d];
+  }
+  return features_size ? byte_size / features_size : 0;
+}
+
 ModelState::ModelState(TRITONBACKEND_Model* triton_model): BackendModel(triton_model){
+  THROW_IF_BACKEND_MODEL_ERROR(BackendState::ForModel(triton_model, &backend_state_));
   THROW_IF_BACKEND_MODEL_ERROR(SupportsFirstDimBatching(&supports_first_dim_batching));
+  common::TritonJson::Value transaction_policy;
+  if(ModelConfig().Find("model_transaction_policy", &transaction_policy) &&
+     transaction_policy.Find("decoupled"))
+    THROW_IF_BACKEND_MODEL_ERROR(transaction_policy.MemberAsBool("decoupled", &decoupled));
   input_tensors = ReadTensorConfig("input");
   output_tensors = ReadTensorConfig("output");
+  input_index_ = BuildTensorIndex(input_tensors);
+  output_index_ = BuildTensorIndex(output_tensors);
+  THROW_IF_BACKEND_MODEL_ERROR(ParseParameters());
+  // after ParseParameters, quantization changes the model types
+  config_fingerprint_ = ConfigFingerprint();
   THROW_IF_BACKEND_MODEL_ERROR(LoadModel());
+  if(!shadow_model_filename_.empty()){
+    TRITONSERVER_Error *err = LoadShadowModel();
+    if(err != nullptr){
+      // the destructor does not run when the constructor throws
+      lazy_library.reset();
+      if(library)
+        backend_state_->Libraries()->Release(library);
+      library = nullptr;
+      throw BackendModelException(err);
+    }
+  }
+  compute_pool = backend_state_->Pool();
+  if(compute_pool)
+    compute_queue = compute_pool->CreateQueue(scheduling_weight_);
 }
 
 ModelState::~ModelState(){
-  if(model_lib)
-    dlclose(model_lib);
+  shadow.reset();
+  if(compute_queue)
+    compute_pool->DestroyQueue(compute_queue);
+  lazy_library.reset();
+  if(library)
+    backend_state_->Libraries()->Release(library);
 }
 
 TRITONSERVER_Error*
@@ -134,23 +250,120 @@ ModelState::Create(TRITONBACKEND_Model* triton_model, ModelState** state){
   return nullptr;  // success
 }
 
+TRITONSERVER_Error*
+ModelState::ParseParameters(){
+  common::TritonJson::Value params;
+  if(!ModelConfig().Find("parameters", &params))
+    return nullptr;
+  RETURN_IF_ERROR(TryParseModelStringParameter(params, "lazy_load", &lazy_load_, false));
+  RETURN_IF_ERROR(TryParseModelStringParameter(params, "idle_unload_seconds", &idle_unload_seconds_, (uint64_t)300));
+  RETURN_IF_ERROR(TryParseModelStringParameter(params, "stream_chunk_bytes", &stream_chunk_bytes, (uint64_t)0));
+  RETURN_IF_ERROR(TryParseModelStringParameter(params, "shadow_model_filename", &shadow_model_filename_, ""));
+  if(!shadow_model_filename_.empty()){
+    std::string sample_rate;
+    RETURN_IF_ERROR(TryParseModelStringParameter(params, "shadow_sample_rate", &sample_rate, "0.01"));
+    RETURN_IF_ERROR(ParseDoubleValue(sample_rate, &shadow_sample_rate_));
+    RETURN_ERROR_IF_FALSE(shadow_sample_rate_ >= 0 && shadow_sample_rate_ <= 1,
+        TRITONSERVER_ERROR_INVALID_ARG,
+        std::string("'shadow_sample_rate' must be between 0 and 1 for model '") + Name() + "'");
+    RETURN_IF_ERROR(TryParseModelStringParameter(params, "shadow_log_interval", &shadow_log_interval_, (uint64_t)100));
+    std::string atol, rtol;
+    RETURN_IF_ERROR(TryParseModelStringParameter(params, "shadow_atol", &atol, "1e-5"));
+    RETURN_IF_ERROR(ParseDoubleValue(atol, &shadow_atol_));
+    RETURN_IF_ERROR(TryParseModelStringParameter(params, "shadow_rtol", &rtol, "1e-3"));
+    RETURN_IF_ERROR(ParseDoubleValue(rtol, &shadow_rtol_));
+    RETURN_ERROR_IF_FALSE(shadow_atol_ >= 0 && shadow_rtol_ >= 0,
+        TRITONSERVER_ERROR_INVALID_ARG,
+        std::string("'shadow_atol' and 'shadow_rtol' must not be negative for model '") + Name() + "'");
+  }
+  RETURN_IF_ERROR(TryParseModelStringParameter(params, "input_alignment", &input_alignment, (uint64_t)ONNXMLIR_DEFAULT_ALIGNMENT));
+  RETURN_ERROR_IF_FALSE(
+      input_alignment >= sizeof(void*) && (input_alignment & (input_alignment - 1)) == 0,
+      TRITONSERVER_ERROR_INVALID_ARG,
+      std::string("'input_alignment' must be a power of two of at least ") +
+          std::to_string(sizeof(void*)) + " for model '" + Name() + "'");
+  int scheduling_weight;
+  RETURN_IF_ERROR(TryParseModelStringParameter(params, "scheduling_weight", &scheduling_weight, 1));
+  RETURN_ERROR_IF_FALSE(scheduling_weight > 0, TRITONSERVER_ERROR_INVALID_ARG,
+      std::string("'scheduling_weight' must be positive for model '") + Name() + "'");
+  scheduling_weight_ = scheduling_weight;
+  bool enable_perf_counters;
+  RETURN_IF_ERROR(TryParseModelStringParameter(params, "enable_perf_counters", &enable_perf_counters, false));
+  if(enable_perf_counters){
+    uint64_t log_interval;
+    RETURN_IF_ERROR(TryParseModelStringParameter(params, "perf_counters_log_interval", &log_interval, (uint64_t)1000));
+    perf_stats.reset(new PerfStats(Name(), log_interval));
+  }
+  std::string numa_nodes;
+  RETURN_IF_ERROR(TryParseModelStringParameter(params, "numa_nodes", &numa_nodes, ""));
+  RETURN_IF_ERROR(ParseIdList(numa_nodes, MAX_NUMA_NODES, &numa_nodes_));
+  for(int node : numa_nodes_){
+    std::vector<int> cpus;
+    RETURN_IF_ERROR(NumaNodeCpus(node, &cpus));
+  }
+  return ParseQuantization(params);
+}
+
+int ModelState::NextNumaNode(){
+  if(numa_nodes_.empty())
+    return -1;
+  return numa_nodes_[next_numa_node_.fetch_add(1) % numa_nodes_.size()];
+}
+
+TRITONSERVER_Error*
+ModelState::ParseQuantization(common::TritonJson::Value &params){
+  static const std::string prefix = "quantization:";
+  std::vector<std::string> keys;
+  RETURN_IF_ERROR(params.Members(&keys));
+  for(const std::string &key : keys){
+    if(key.compare(0, prefix.size(), prefix) != 0)
+      continue;
+    std::string tensor = key.substr(prefix.size());
+    std::string spec;
+    RETURN_IF_ERROR(TryParseModelStringParameter(params, key, &spec, ""));
+    auto input = input_index_.find(tensor);
+    auto output = output_index_.find(tensor);
+    RETURN_ERROR_IF_TRUE(
+        input == input_index_.end() && output == output_index_.end(),
+        TRITONSERVER_ERROR_INVALID_ARG,
+        "'" + key + "' names no input or output of model '" + Name() + "'");
+    if(input != input_index_.end())
+      RETURN_IF_ERROR(input_tensors[input->second].SetQuantization(spec));
+    if(output != output_index_.end())
+      RETURN_IF_ERROR(output_tensors[output->second].SetQuantization(spec));
+  }
+  return nullptr;
+}
+
 std::vector<TensorDef> ModelState::ReadTensorConfig(const char *member){
   std::vector<TensorDef> ret;
   common::TritonJson::Value tensors;
   THROW_IF_BACKEND_MODEL_ERROR(ModelConfig().MemberAsArray(member, &tensors));
+  ret.reserve(tensors.ArraySize());
   for(size_t i = 0; i< tensors.ArraySize(); i++){
     common::TritonJson::Value tensor;
     THROW_IF_BACKEND_MODEL_ERROR(tensors.IndexAsObject(i, &tensor));
-    TensorDef tensor_def(tensor, supports_first_dim_batching);
-    ret.push_back(tensor_def);
+    ret.emplace_back(tensor, supports_first_dim_batching);
   }
   return ret;
 }
 
-bool CheckSignature(const char *signature, std::vector<TensorDef> &config, std::string &error){
+TensorIndex BuildTensorIndex(const std::vector<TensorDef> &config){
+  TensorIndex index;
+  index.reserve(config.size());
+  for(size_t i = 0; i < config.size(); i++)
+    index.emplace(config[i].name, i);
+  return index;
+}
+
+bool CheckSignature(const char *signature, const std::vector<TensorDef> &config,
+                    const TensorIndex &index, std::string &error){
+  // Parsing in place on a single copy saves an allocation per string
+  // of the signature, which adds up for thousands of tensors.
+  std::vector<char> buffer(signature, signature + strlen(signature) + 1);
   rapidjson::Document d;
-  d.Parse(signature);
-  if(d.HasParseError()){
+  d.ParseInsitu(buffer.data());
+  if(d.HasParseError() || !d.IsArray()){
     error = "Signature Parse Error";
     return false;
   }
@@ -159,15 +372,33 @@ bool CheckSignature(const char *signature, std::vector<TensorDef> &config, std::
     return false;
   }
   for (rapidjson::SizeType i = 0; i < d.Size(); i++){
-      const rapidjson::Value& tensor = d[i];
-      if(!config[i].CheckSignature(tensor, error))
-        return false;
+    const rapidjson::Value& tensor = d[i];
+    rapidjson::Value::ConstMemberIterator name = tensor.FindMember("name");
+    if(name == tensor.MemberEnd() || !name->value.IsString()){
+      error = "name of tensor " + std::to_string(i) + " missing";
+      return false;
+    }
+    // Tensors are passed by position, so the config must list them in
+    // the order of the model.
+    const TensorDef &def = config[i];
+    if(def.name.size() != name->value.GetStringLength() ||
+       def.name.compare(0, def.name.size(), name->value.GetString(),
+                        name->value.GetStringLength()) != 0){
+      std::string model_name(name->value.GetString(), name->value.GetStringLength());
+      auto pos = index.find(model_name);
+      if(pos == index.end())
+        error = "name: '" + model_name + "' is not in the config";
+      else
+        error = "order: '" + model_name + "' is tensor " + std::to_string(i) +
+                " of the model but " + std::to_string(pos->second) + " of the config";
+      return false;
+    }
+    if(!def.CheckSignature(tensor, error))
+      return false;
   }
   return true;
 }
 
-#define RETURN_DLERROR_IF_NULL(x) RETURN_ERROR_IF_FALSE(x, TRITONSERVER_ERROR_UNAVAILABLE, std::string(dlerror()))
-
 TRITONSERVER_Error*
 ModelState::LoadModel(){
   std::string so_model_filename = "model.so";
@@ -180,36 +411,136 @@ ModelState::LoadModel(){
         std::string("unable to find '") + model_path + "' for model '" +
             Name() + "'");
   }
-  LOG_MESSAGE(TRITONSERVER_LOG_VERBOSE,("Loading " + model_path).c_str());
-  model_lib = dlopen(model_path.c_str(), RTLD_LAZY);
-  RETURN_ERROR_IF_FALSE(model_lib, TRITONSERVER_ERROR_UNAVAILABLE, std::string("failed to load ") + model_path + ": " + dlerror());
-  dll_omQueryEntryPoints = (const char* const* (*)(int64_t*)) dlsym(model_lib, "omQueryEntryPoints");
-  RETURN_DLERROR_IF_NULL(dll_omQueryEntryPoints);
-  dll_omInputSignature = (const char* (*)(const char *)) dlsym(model_lib, "omInputSignature");
-  RETURN_DLERROR_IF_NULL(dll_omInputSignature);
-  dll_omOutputSignature = (const char* (*)(const char *)) dlsym(model_lib, "omOutputSignature");
-  RETURN_DLERROR_IF_NULL(dll_omOutputSignature);
-  
+  // A lazily loaded model whose library already passed the signature
+  // check (reload, or another model with the same model.so) is not
+  // loaded at all until the first execute. Only shared libraries are
+  // hashed and so can be in the cache.
+  if(lazy_load_ && backend_state_->Libraries()->SharesLibraries()){
+    uint64_t hash, file_size;
+    RETURN_IF_ERROR(HashModelFiles(model_path, &hash, &file_size));
+    if(backend_state_->SignatureValidated(hash, file_size, config_fingerprint_)){
+      LOG_VERBOSE(("Signature of " + model_path + " already validated, deferring load").c_str());
+      lazy_library.reset(new LazyModelLibrary(
+          backend_state_->Libraries(), model_path, hash,
+          idle_unload_seconds_ * 1000000000ULL));
+      return nullptr;
+    }
+  }
+  RETURN_IF_ERROR(backend_state_->Libraries()->Acquire(model_path, &library));
+  TRITONSERVER_Error *err = CheckLibrary(library);
+  if(err != nullptr || lazy_load_){
+    // a lazily loaded model only keeps the validated path until the
+    // first execute
+    if(err == nullptr)
+      lazy_library.reset(new LazyModelLibrary(
+          backend_state_->Libraries(), model_path, library->ContentHash(),
+          idle_unload_seconds_ * 1000000000ULL));
+    backend_state_->Libraries()->Release(library);
+    library = nullptr;
+  }
+  return err;
+}
+
+TRITONSERVER_Error*
+ModelState::LoadShadowModel(){
+  std::string shadow_path = JoinPath({ RepositoryPath(), std::to_string(Version()), shadow_model_filename_});
+  {
+    bool exists;
+    RETURN_IF_ERROR(FileExists(shadow_path, &exists));
+    RETURN_ERROR_IF_FALSE(
+        exists, TRITONSERVER_ERROR_UNAVAILABLE,
+        std::string("unable to find shadow model '") + shadow_path + "' for model '" +
+            Name() + "'");
+  }
+  ModelLibrary *candidate;
+  RETURN_IF_ERROR(backend_state_->Libraries()->Acquire(shadow_path, &candidate));
+  TRITONSERVER_Error *err = CheckLibrary(candidate);
+  if(err != nullptr){
+    backend_state_->Libraries()->Release(candidate);
+    return err;
+  }
+  shadow.reset(new ShadowRunner(Name(), backend_state_->Libraries(), candidate,
+                                shadow_sample_rate_, shadow_log_interval_,
+                                shadow_atol_, shadow_rtol_));
+  return nullptr;
+}
+
+TRITONSERVER_Error*
+ModelState::PinLibrary(ModelLibrary **lib){
+  if(!lazy_library){
+    *lib = library;
+    return nullptr;
+  }
+  return lazy_library->Pin(lib);
+}
+
+void ModelState::UnpinLibrary(){
+  if(lazy_library)
+    lazy_library->Unpin();
+}
+
+TRITONSERVER_Error* ScopedLibraryPin::Pin(){
+  return model_state_->PinLibrary(&library_);
+}
+
+ScopedLibraryPin::~ScopedLibraryPin(){
+  if(library_)
+    model_state_->UnpinLibrary();
+}
+
+uint64_t ModelState::ConfigFingerprint() const {
+  // FNV-1a over everything CheckLibrary compares
+  uint64_t h = 0xcbf29ce484222325ULL;
+  auto mix = [&h](const void *data, size_t size){
+    const unsigned char *bytes = (const unsigned char*)data;
+    for(size_t i = 0; i < size; i++)
+      h = (h ^ bytes[i]) * 0x100000001b3ULL;
+  };
+  for(const std::vector<TensorDef> *tensors : {&input_tensors, &output_tensors}){
+    uint64_t count = tensors->size();
+    mix(&count, sizeof(count));
+    for(const TensorDef &def : *tensors){
+      mix(def.name.c_str(), def.name.size() + 1);
+      mix(&def.om_dtype, sizeof(def.om_dtype));
+      uint64_t rank = def.shape.size();
+      mix(&rank, sizeof(rank));
+      mix(def.shape.data(), def.shape.size() * sizeof(int64_t));
+    }
+  }
+  return h;
+}
+
+TRITONSERVER_Error*
+ModelState::CheckLibrary(ModelLibrary *lib){
+  // Reloads, models sharing a library and shadow builds identical to
+  // model.so skip the check. The content hash is only known (non zero)
+  // with shared-model-libraries.
+  const bool cacheable = lib->ContentHash() != 0;
+  if(cacheable && backend_state_->SignatureValidated(
+                      lib->ContentHash(), lib->FileSize(), config_fingerprint_)){
+    LOG_VERBOSE(("Signature of " + lib->Path() + " already validated").c_str());
+    return nullptr;
+  }
   int64_t num_entry_points;
-  const char* const* entry_points = dll_omQueryEntryPoints(&num_entry_points);
+  const char* const* entry_points = lib->dll_omQueryEntryPoints(&num_entry_points);
   const char *entry_point = "run_main_graph";
   bool found = false;
   for(int64_t i=0; i < num_entry_points; i++){
     if(strcmp(entry_point, entry_points[i]))
       continue;
-    std::string input_sig(dll_omInputSignature(entry_points[i]));
-    std::string output_sig(dll_omOutputSignature(entry_points[i]));
-    LOG_MESSAGE(TRITONSERVER_LOG_VERBOSE,("entrypoint: " + std::string(entry_points[i])
-                                        + "\n input:\n" + input_sig
-                                        + "\n output:\n" + output_sig ).c_str());
-    std::string error;                                        
+    const char *input_sig = lib->dll_omInputSignature(entry_points[i]);
+    const char *output_sig = lib->dll_omOutputSignature(entry_points[i]);
+    LOG_VERBOSE(("entrypoint: " + std::string(entry_points[i])
+                 + "\n input:\n" + input_sig
+                 + "\n output:\n" + output_sig ).c_str());
+    std::string error;
     RETURN_ERROR_IF_FALSE(
-        CheckSignature(input_sig.c_str(), input_tensors, error),
+        CheckSignature(input_sig, input_tensors, input_index_, error),
         TRITONSERVER_ERROR_UNAVAILABLE,
         "input signature for entry point '" + std::string(entry_point) + " for model '" +
             Name() + "' mismatches config: " + error);
     RETURN_ERROR_IF_FALSE(
-        CheckSignature(output_sig.c_str(), output_tensors, error),
+        CheckSignature(output_sig, output_tensors, output_index_, error),
         TRITONSERVER_ERROR_UNAVAILABLE,
         "output signature for entry point '" + std::string(entry_point) + " for model '" +
             Name() + "' mismatches config: " + error);
@@ -220,28 +551,8 @@ ModelState::LoadModel(){
         found, TRITONSERVER_ERROR_UNAVAILABLE,
         "unable to find entry point '" + std::string(entry_point) + " for model '" +
             Name() + "'");
-  dll_run_main_graph = (OMTensorList * (*)(OMTensorList *)) dlsym(model_lib, entry_point);
-  RETURN_DLERROR_IF_NULL(dll_run_main_graph);
-  dll_omTensorCreate = (OMTensor * (*)(void *, int64_t *, int64_t, OM_DATA_TYPE)) dlsym(model_lib, "omTensorCreate");
-  RETURN_DLERROR_IF_NULL(dll_omTensorCreate);
-  dll_omTensorListCreate = (OMTensorList * (*)(OMTensor **, int)) dlsym(model_lib, "omTensorListCreate");
-  RETURN_DLERROR_IF_NULL(dll_omTensorListCreate);
-  dll_omTensorListGetOmtByIndex = (OMTensor * (*)(OMTensorList *, int64_t)) dlsym(model_lib, "omTensorListGetOmtByIndex");
-  RETURN_DLERROR_IF_NULL(dll_omTensorListGetOmtByIndex);
-  dll_omTensorGetDataPtr = (void* (*)(OMTensor *))dlsym(model_lib, "omTensorGetDataPtr");
-  RETURN_DLERROR_IF_NULL( dll_omTensorGetDataPtr);
-  dll_omTensorGetRank = (int64_t (*)(OMTensor *))dlsym(model_lib, "omTensorGetRank");
-  RETURN_DLERROR_IF_NULL( dll_omTensorGetRank);
-  dll_omTensorGetShape = (int64_t* (*)(OMTensor *))dlsym(model_lib, "omTensorGetShape");
-  RETURN_DLERROR_IF_NULL( dll_omTensorGetShape);
-  dll_omTensorGetDataType = (OM_DATA_TYPE (*)(OMTensor *))dlsym(model_lib, "omTensorGetDataType");
-  RETURN_DLERROR_IF_NULL( dll_omTensorGetDataType);
-  dll_omTensorListGetSize = (int64_t (*)(OMTensorList *))dlsym(model_lib, "omTensorListGetSize");
-  RETURN_DLERROR_IF_NULL(dll_omTensorListGetSize);
-  dll_omTensorListDestroy = (void (*)(OMTensorList *))dlsym(model_lib, "omTensorListDestroy");
-  RETURN_DLERROR_IF_NULL(dll_omTensorListDestroy);
-  dll_omTensorDestroy = (void (*)(OMTensor *))dlsym(model_lib, "omTensorDestroy");
-  RETURN_DLERROR_IF_NULL(dll_omTensorDestroy);
+  if(cacheable)
+    backend_state_->AddValidatedSignature(lib->ContentHash(), lib->FileSize(), config_fingerprint_);
   return nullptr;
 }
 
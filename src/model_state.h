@@ -29,14 +29,23 @@
 #ifndef ONNX_MLIR_MODEL_STATE_H
 #define ONNX_MLIR_MODEL_STATE_H
  
+#include <atomic>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include "triton/backend/backend_model.h"
+#include "aligned_buffer.h"
+#include "compute_pool.h"
+#include "model_library.h"
+#include "perf_counters.h"
+#include "shadow_runner.h"
 
 #include <OnnxMlirRuntime.h>
 
 
 namespace triton { namespace backend { namespace onnxmlir {
 
+class BackendState;
 class ModelState;
 
 class TensorDef {
@@ -44,13 +53,60 @@ class TensorDef {
     std::string name;
     std::vector<int64_t> shape;
     int64_t size;
+    // Type of the model tensor.
     OM_DATA_TYPE om_dtype;
+    uint32_t om_dtype_size;
+    // Type exchanged with clients, the config's data_type.
     TRITONSERVER_DataType triton_dtype;
     uint32_t dtype_size;
     int64_t byte_size;
+    bool batched;
+    // Quantized tensors are exchanged as INT8/UINT8 'triton_dtype' while
+    // the model uses FLOAT, see Quantize() and Dequantize().
+    bool quantized = false;
+    float scale = 1;
+    int32_t zero_point = 0;
     TensorDef(triton::common::TritonJson::Value &tensor, bool supports_first_dim_batching);
-    bool CheckTensorMatches(ModelState *model_state, OMTensor *tensor, std::string &error);
-    bool CheckSignature(const rapidjson::Value &signature, std::string &error);
+    // Exchange the tensor quantized, 'spec' is "scale=<float>,zero_point=<int>".
+    TRITONSERVER_Error* SetQuantization(const std::string &spec);
+    // Convert 'count' elements between the wire and the model type.
+    void Dequantize(const char *wire, char *model, size_t count) const;
+    void Quantize(const char *model, char *wire, size_t count) const;
+    bool CheckTensorMatches(const ModelLibrary *library, OMTensor *tensor, std::string &error);
+    bool CheckSignature(const rapidjson::Value &signature, std::string &error) const;
+    // First dimension of a batch of 'byte_size' bytes whose other
+    // dimensions are those of 'shape'.
+    int64_t BatchSize(const int64_t *shape, uint32_t dims_count, size_t byte_size) const;
+};
+
+// Position of each tensor of the config by name.
+typedef std::unordered_map<std::string, size_t> TensorIndex;
+TensorIndex BuildTensorIndex(const std::vector<TensorDef> &config);
+
+// Check the JSON signature of an entry point (omInputSignature or
+// omOutputSignature) against the tensors of the model config, 'index'
+// is the index of 'config'.
+bool CheckSignature(const char *signature, const std::vector<TensorDef> &config,
+                    const TensorIndex &index, std::string &error);
+
+/////////////
+
+//
+// ScopedLibraryPin
+//
+// Keeps the model library pinned (see ModelState::PinLibrary) for as
+// long as it is in scope.
+//
+class ScopedLibraryPin {
+ public:
+  explicit ScopedLibraryPin(ModelState *model_state) : model_state_(model_state) {}
+  ~ScopedLibraryPin();
+  TRITONSERVER_Error* Pin();
+  ModelLibrary* Get() const { return library_; }
+
+ private:
+  ModelState *model_state_;
+  ModelLibrary *library_ = nullptr;
 };
 
 /////////////
@@ -72,26 +128,62 @@ class ModelState : public BackendModel {
   std::vector<TensorDef> input_tensors;
   std::vector<TensorDef> output_tensors;
   bool supports_first_dim_batching;
-  const char* const* (*dll_omQueryEntryPoints)(int64_t*);
-  const char* (*dll_omInputSignature)(const char *);
-  const char* (*dll_omOutputSignature)(const char *);
-  OMTensorList* (*dll_run_main_graph)(OMTensorList *);
-  OMTensor* (*dll_omTensorCreate)(void *, int64_t *, int64_t, OM_DATA_TYPE);
-  OMTensorList *(*dll_omTensorListCreate)(OMTensor **, int);
-  OMTensor* (*dll_omTensorListGetOmtByIndex)(OMTensorList *, int64_t);
-  void* (*dll_omTensorGetDataPtr)(OMTensor *);
-  int64_t (*dll_omTensorGetRank)(OMTensor *);
-  int64_t* (*dll_omTensorGetShape)(OMTensor *);
-  OM_DATA_TYPE (*dll_omTensorGetDataType)(OMTensor *);
-  void (*dll_omTensorDestroy)(OMTensor *tensor);
-  int64_t (*dll_omTensorListGetSize)(OMTensorList *);
-  void (*dll_omTensorListDestroy)(OMTensorList *);
+  // Decoupled transaction policy: outputs are streamed as partial
+  // responses of at most 'stream_chunk_bytes' (0: one per output).
+  bool decoupled = false;
+  uint64_t stream_chunk_bytes = 0;
+  // Alignment of the gathered input buffers.
+  uint64_t input_alignment = ONNXMLIR_DEFAULT_ALIGNMENT;
+  // The loaded model.so, possibly shared with other models. nullptr
+  // for lazily loaded models, use PinLibrary() in that case.
+  ModelLibrary *library = nullptr;
+  std::unique_ptr<LazyModelLibrary> lazy_library;
+  // Get the model library for an execution, loading it first for lazily
+  // loaded models. Every successful call must be matched by UnpinLibrary().
+  TRITONSERVER_Error* PinLibrary(ModelLibrary **lib);
+  void UnpinLibrary();
+  // Hardware counter profiling of the execute phases, nullptr unless
+  // enabled with the 'enable_perf_counters' model parameter.
+  std::unique_ptr<PerfStats> perf_stats;
+  // The backend's shared compute pool and this model's queue in it,
+  // both nullptr if the pool is not enabled.
+  ComputePool *compute_pool = nullptr;
+  ComputePool::Queue *compute_queue = nullptr;
+  // Candidate build compared against model.so on sampled batches,
+  // nullptr unless 'shadow_model_filename' is set.
+  std::unique_ptr<ShadowRunner> shadow;
+  // NUMA node for the next instance from the 'numa_nodes' parameter,
+  // round robin, -1 if not set.
+  int NextNumaNode();
+  BackendState *Backend() const { return backend_state_; }
 
  private:
   ModelState(TRITONBACKEND_Model* triton_model);
+  TRITONSERVER_Error* ParseParameters();
   std::vector<TensorDef> ReadTensorConfig(const char *member);
+  // Apply the 'quantization:<tensor>' parameters.
+  TRITONSERVER_Error* ParseQuantization(common::TritonJson::Value &params);
   TRITONSERVER_Error* LoadModel();
-  void *model_lib = nullptr;
+  // Check the entry point signatures of 'lib' against the config.
+  TRITONSERVER_Error* CheckLibrary(ModelLibrary *lib);
+  // Hash of the tensor configs, identifies the config in the backend's
+  // cache of validated signatures.
+  uint64_t ConfigFingerprint() const;
+  TRITONSERVER_Error* LoadShadowModel();
+  BackendState *backend_state_;
+  TensorIndex input_index_;
+  TensorIndex output_index_;
+  uint64_t config_fingerprint_ = 0;
+  bool lazy_load_ = false;
+  uint64_t idle_unload_seconds_ = 0;
+  uint32_t scheduling_weight_ = 1;
+  std::string shadow_model_filename_;
+  double shadow_sample_rate_ = 0;
+  uint64_t shadow_log_interval_ = 0;
+  double shadow_atol_ = 0;
+  double shadow_rtol_ = 0;
+  std::vector<int> numa_nodes_;
+  std::atomic<uint32_t> next_numa_node_{0};
 };
 
 }}}  // namespace triton::backend::onnxmlir
@@ -0,0 +1,140 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#include "numa.h"
+
+#include "triton/backend/backend_common.h"
+
+#include <cstdlib>
+#include <fstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+namespace {
+
+#ifdef __linux__
+static_assert(MAX_CPUS == CPU_SETSIZE, "MAX_CPUS must match cpu_set_t");
+
+// from linux/mempolicy.h, which is not installed everywhere
+const int MPOL_PREFERRED = 1;
+const int MPOL_BIND = 2;
+const unsigned MPOL_MF_MOVE = 1 << 1;
+const int BITS_PER_LONG = 8 * sizeof(unsigned long);
+
+struct NodeMask {
+  unsigned long bits[MAX_NUMA_NODES / BITS_PER_LONG] = {};
+  explicit NodeMask(int node){ bits[node / BITS_PER_LONG] = 1UL << (node % BITS_PER_LONG); }
+  // one more than the mask size, the kernel drops the last bit of
+  // 'maxnode' (libnuma passes it the same way)
+  unsigned long MaxNode() const { return MAX_NUMA_NODES + 1; }
+};
+#endif
+
+TRITONSERVER_Error* CheckNode(int node){
+  RETURN_ERROR_IF_FALSE(node >= 0 && node < MAX_NUMA_NODES, TRITONSERVER_ERROR_INVALID_ARG,
+      "invalid NUMA node " + std::to_string(node));
+  return nullptr;
+}
+
+}  // namespace
+
+TRITONSERVER_Error* ParseIdList(const std::string &list, int max_id, std::vector<int> *ids){
+  ids->clear();
+  size_t begin = 0;
+  while(begin < list.size()){
+    size_t end = list.find(',', begin);
+    if(end == std::string::npos)
+      end = list.size();
+    std::string range = list.substr(begin, end - begin);
+    begin = end + 1;
+    if(range.empty() || range == "\n")
+      continue;
+    char *rest;
+    long first = strtol(range.c_str(), &rest, 10);
+    long last = first;
+    if(*rest == '-')
+      last = strtol(rest + 1, &rest, 10);
+    RETURN_ERROR_IF_FALSE(
+        rest != range.c_str() && (*rest == '\0' || *rest == '\n') && first >= 0 && last >= first,
+        TRITONSERVER_ERROR_INVALID_ARG, "invalid list '" + list + "'");
+    // before expanding, "0-2000000000" must not fill the list
+    RETURN_ERROR_IF_TRUE(last >= max_id, TRITONSERVER_ERROR_INVALID_ARG,
+        "id " + std::to_string(last) + " of '" + list + "' is not below " + std::to_string(max_id));
+    for(long id = first; id <= last; id++)
+      ids->push_back(id);
+  }
+  return nullptr;
+}
+
+TRITONSERVER_Error* NumaNodeCpus(int node, std::vector<int> *cpus){
+  RETURN_IF_ERROR(CheckNode(node));
+  std::string path = "/sys/devices/system/node/node" + std::to_string(node) + "/cpulist";
+  std::ifstream file(path);
+  RETURN_ERROR_IF_FALSE(file.good(), TRITONSERVER_ERROR_INVALID_ARG,
+      "NUMA node " + std::to_string(node) + " does not exist");
+  std::string list;
+  std::getline(file, list);
+  RETURN_IF_ERROR(ParseIdList(list, MAX_CPUS, cpus));
+  RETURN_ERROR_IF_TRUE(cpus->empty(), TRITONSERVER_ERROR_INVALID_ARG,
+      "NUMA node " + std::to_string(node) + " has no CPUs");
+  return nullptr;
+}
+
+TRITONSERVER_Error* BindThreadToNumaNode(int node){
+#ifdef __linux__
+  std::vector<int> cpus;
+  RETURN_IF_ERROR(NumaNodeCpus(node, &cpus));
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for(int cpu : cpus)
+    CPU_SET(cpu, &cpu_set);
+  int err = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+  RETURN_ERROR_IF_TRUE(err != 0, TRITONSERVER_ERROR_INTERNAL,
+      "failed to bind thread to the CPUs of NUMA node " + std::to_string(node) +
+      ": " + strerror(err));
+  // preferred, not bound: the model's own allocations may still fall
+  // back to other nodes when this one is full
+  NodeMask mask(node);
+  RETURN_ERROR_IF_TRUE(
+      syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.bits, mask.MaxNode()) != 0,
+      TRITONSERVER_ERROR_INTERNAL,
+      "failed to set the memory policy for NUMA node " + std::to_string(node) +
+      ": " + strerror(errno));
+  return nullptr;
+#else
+  return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_UNSUPPORTED, "NUMA binding is only supported on Linux");
+#endif
+}
+
+TRITONSERVER_Error* BindMemoryToNumaNode(void *addr, size_t size, int node){
+#ifdef __linux__
+  RETURN_IF_ERROR(CheckNode(node));
+  NodeMask mask(node);
+  RETURN_ERROR_IF_TRUE(
+      syscall(SYS_mbind, addr, size, MPOL_BIND, mask.bits, mask.MaxNode(), MPOL_MF_MOVE) != 0,
+      TRITONSERVER_ERROR_INTERNAL,
+      "failed to bind memory to NUMA node " + std::to_string(node) + ": " + strerror(errno));
+  return nullptr;
+#else
+  return TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_UNSUPPORTED, "NUMA binding is only supported on Linux");
+#endif
+}
+
+size_t PageSize(){
+#ifdef __linux__
+  static const size_t page_size = sysconf(_SC_PAGESIZE);
+  return page_size;
+#else
+  return 4096;
+#endif
+}
+
+}}}  // namespace triton::backend::onnxmlir
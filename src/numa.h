@@ -0,0 +1,38 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#ifndef ONNX_MLIR_NUMA_H
+#define ONNX_MLIR_NUMA_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "triton/core/tritonserver.h"
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+// NUMA placement through the system calls directly, so the backend
+// does not depend on libnuma. Only supported on Linux, elsewhere the
+// binding functions fail.
+
+// Node masks passed to the kernel cover this many nodes.
+const int MAX_NUMA_NODES = 1024;
+// CPUs that fit into a cpu_set_t (CPU_SETSIZE of glibc).
+const int MAX_CPUS = 1024;
+
+// CPUs of NUMA 'node' from /sys/devices/system/node/node<N>/cpulist,
+// fails if the node does not exist.
+TRITONSERVER_Error* NumaNodeCpus(int node, std::vector<int> *cpus);
+// Parse a list in the kernel's cpu and node list format, e.g. "0-15,32-47",
+// fails for ids of 'max_id' and above.
+TRITONSERVER_Error* ParseIdList(const std::string &list, int max_id, std::vector<int> *ids);
+// Run the calling thread on the CPUs of 'node' and prefer memory of
+// 'node' for its allocations.
+TRITONSERVER_Error* BindThreadToNumaNode(int node);
+// Move the pages of [addr, addr + size) to 'node' and keep them there.
+// 'addr' must be page aligned.
+TRITONSERVER_Error* BindMemoryToNumaNode(void *addr, size_t size, int node);
+size_t PageSize();
+
+}}}  // namespace triton::backend::onnxmlir
+
+#endif //ONNX_MLIR_NUMA_H
@@ -27,7 +27,9 @@
 // OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "model_instance_state.h"
+#include "onnxmlir_trace.h"
 #include "onnxmlir_typemapping.h"
+#include "perf_counters.h"
 
 #include "triton/backend/backend_common.h"
 #include "triton/backend/backend_input_collector.h"
@@ -37,33 +39,197 @@
 #include "triton/core/tritonbackend.h"
 #include <OnnxMlirRuntime.h>
 
+#include <algorithm>
+#include <cstring>
+
 namespace triton { namespace backend { namespace onnxmlir {
 
-extern "C" {
+namespace {
 
-// When Triton calls TRITONBACKEND_ModelInstanceExecute it is required
-// that a backend create a response for each request in the batch. A
-// response may be the output tensors required for that request or may
-// be an error that is returned in the response.
+// Total byte size of input 'name' over all requests. 'in_place' tells
+// whether the input already is a single CPU buffer with the required
+// alignment that can be used without gathering it.
+TRITONSERVER_Error*
+InputBatchByteSize(
+    TRITONBACKEND_Request** requests, const uint32_t request_count,
+    const char* name, uint64_t alignment, uint64_t* byte_size, bool* in_place)
+{
+  *byte_size = 0;
+  *in_place = false;
+  uint32_t buffer_count = 0;
+  TRITONBACKEND_Input* input = nullptr;
+  for(uint32_t r = 0; r < request_count; r++){
+    uint64_t request_byte_size;
+    RETURN_IF_ERROR(TRITONBACKEND_RequestInput(requests[r], name, &input));
+    RETURN_IF_ERROR(TRITONBACKEND_InputProperties(
+        input, nullptr, nullptr, nullptr, nullptr, &request_byte_size, &buffer_count));
+    *byte_size += request_byte_size;
+  }
+  if(request_count == 1 && buffer_count == 1){
+    const void* buffer;
+    uint64_t buffer_byte_size;
+    TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
+    int64_t memory_type_id = 0;
+    RETURN_IF_ERROR(TRITONBACKEND_InputBuffer(
+        input, 0, &buffer, &buffer_byte_size, &memory_type, &memory_type_id));
+    *in_place = memory_type != TRITONSERVER_MEMORY_GPU &&
+                ((uintptr_t)buffer & (alignment - 1)) == 0;
+  }
+  return nullptr;
+}
+
+// Send one output slice of a request as partial response of a
+// decoupled model.
+TRITONSERVER_Error*
+SendPartialOutput(
+    TRITONBACKEND_ResponseFactory* factory, const TensorDef& output_def,
+    const std::vector<int64_t>& shape, const char* data, size_t byte_size)
+{
+  TRITONBACKEND_Response* response;
+  RETURN_IF_ERROR(TRITONBACKEND_ResponseNewFromFactory(&response, factory));
+  TRITONBACKEND_Output* output;
+  void* buffer;
+  TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
+  int64_t memory_type_id = 0;
+  TRITONSERVER_Error* err = TRITONBACKEND_ResponseOutput(
+      response, &output, output_def.name.c_str(), output_def.triton_dtype,
+      shape.data(), shape.size());
+  if(err == nullptr)
+    err = TRITONBACKEND_OutputBuffer(
+        output, &buffer, byte_size, &memory_type, &memory_type_id);
+  if(err == nullptr && memory_type == TRITONSERVER_MEMORY_GPU)
+    err = TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_UNSUPPORTED,
+        "'onnxmlir' backend: GPU output buffers are not supported");
+  if(err != nullptr){
+    LOG_IF_ERROR(TRITONBACKEND_ResponseDelete(response), "failed to delete response");
+    return err;
+  }
+  memcpy(buffer, data, byte_size);
+  return TRITONBACKEND_ResponseSend(response, 0 /* not final */, nullptr);
+}
+
+// For decoupled models, instead of one response with all outputs,
+// every request gets a stream of partial responses: one per output
+// tensor, split into chunks of at most 'stream_chunk_bytes'. The
+// stream is closed by the final flag once all chunks are sent, and
+// 'responses' are consumed. 'output_data' is the data of each output
+// in its wire type.
+void
+StreamResponses(
+    ModelState* model_state, ModelLibrary* library,
+    TRITONBACKEND_Request** requests, const uint32_t request_count,
+    std::vector<TRITONBACKEND_Response*>* responses,
+    OMTensorList* om_output_tl, const char* const* output_data, int64_t output_size)
+{
+  // rows of the batch belonging to each request
+  std::vector<int64_t> request_rows(request_count, 1);
+  if(model_state->supports_first_dim_batching){
+    for(uint32_t r = 0; r < request_count; r++){
+      TRITONBACKEND_Input* input;
+      const int64_t* shape;
+      uint32_t dims_count;
+      RESPOND_AND_SET_NULL_IF_ERROR(&(*responses)[r],
+          TRITONBACKEND_RequestInput(
+              requests[r], model_state->input_tensors[0].name.c_str(), &input));
+      if((*responses)[r] == nullptr)
+        continue;
+      RESPOND_AND_SET_NULL_IF_ERROR(&(*responses)[r],
+          TRITONBACKEND_InputProperties(
+              input, nullptr, nullptr, &shape, &dims_count, nullptr, nullptr));
+      if((*responses)[r] != nullptr && dims_count > 0)
+        request_rows[r] = shape[0];
+    }
+  }
+
+  int64_t row_offset = 0;
+  for(uint32_t r = 0; r < request_count; r++){
+    TRITONBACKEND_Response*& final_response = (*responses)[r];
+    int64_t rows = request_rows[r];
+    int64_t first_row = row_offset;
+    row_offset += rows;
+    if(final_response == nullptr)
+      continue;
+    TRITONBACKEND_ResponseFactory* factory;
+    RESPOND_AND_SET_NULL_IF_ERROR(&final_response,
+        TRITONBACKEND_ResponseFactoryNew(&factory, requests[r]));
+    if(final_response == nullptr)
+      continue;
+
+    for(int64_t i = 0; i < output_size && final_response != nullptr; i++){
+      const TensorDef& output_def = model_state->output_tensors[i];
+      OMTensor *om_output = library->dll_omTensorListGetOmtByIndex(om_output_tl, i);
+      const char *data = output_data[i];
+      int64_t rank = library->dll_omTensorGetRank(om_output);
+      int64_t *shape_ptr = library->dll_omTensorGetShape(om_output);
+      std::vector<int64_t> shape(shape_ptr, shape_ptr + rank);
+      int64_t element_count = GetElementCount(shape);
+      if(model_state->supports_first_dim_batching){
+        if(rank == 0 || first_row + rows > shape[0]){
+          RESPOND_AND_SET_NULL_IF_ERROR(&final_response,
+              TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG,
+                  ("model output '" + output_def.name +
+                   "' does not match the batch size").c_str()));
+          break;
+        }
+        int64_t row_elements = shape[0] > 0 ? element_count / shape[0] : 0;
+        element_count = row_elements * rows;
+        data += row_elements * first_row * output_def.dtype_size;
+        shape[0] = rows;
+      }
+
+      // Chunks are cut along the outermost dimension that is not 1, so
+      // every chunk is a contiguous part of the output.
+      size_t chunk_dim = 0;
+      while(chunk_dim < shape.size() && shape[chunk_dim] == 1)
+        chunk_dim++;
+      int64_t extent = chunk_dim < shape.size() ? shape[chunk_dim] : 1;
+      size_t slice_bytes = extent > 0 ? element_count / extent * output_def.dtype_size : 0;
+      int64_t slices_per_chunk = extent;
+      if(model_state->stream_chunk_bytes > 0 && slice_bytes > 0)
+        slices_per_chunk = std::max<int64_t>(1, model_state->stream_chunk_bytes / slice_bytes);
+      for(int64_t start = 0; start < extent || start == 0; start += slices_per_chunk){
+        int64_t count = std::min(slices_per_chunk, extent - start);
+        std::vector<int64_t> chunk_shape(shape);
+        if(chunk_dim < shape.size())
+          chunk_shape[chunk_dim] = count;
+        RESPOND_AND_SET_NULL_IF_ERROR(&final_response,
+            SendPartialOutput(factory, output_def, chunk_shape,
+                data + start * slice_bytes, count * slice_bytes));
+        if(final_response == nullptr || extent == 0)
+          break;
+      }
+    }
+
+    // Everything was streamed, close the stream without another response.
+    if(final_response != nullptr){
+      LOG_IF_ERROR(TRITONBACKEND_ResponseDelete(final_response), "failed to delete response");
+      final_response = nullptr;
+      LOG_IF_ERROR(
+          TRITONBACKEND_ResponseFactorySendFlags(
+              factory, TRITONSERVER_RESPONSE_COMPLETE_FINAL),
+          "failed to send final flag");
+    }
+    LOG_IF_ERROR(TRITONBACKEND_ResponseFactoryDelete(factory), "failed to delete response factory");
+  }
+}
+
+// Process a batch of requests on the calling thread, this is the body
+// of TRITONBACKEND_ModelInstanceExecute.
 //
 TRITONSERVER_Error*
-TRITONBACKEND_ModelInstanceExecute(
-    TRITONBACKEND_ModelInstance* instance, TRITONBACKEND_Request** requests,
+ExecuteRequests(
+    ModelInstanceState* instance_state, TRITONBACKEND_Request** requests,
     const uint32_t request_count)
 {
-  LOG_MESSAGE(TRITONSERVER_LOG_VERBOSE,"onnxmlir ModelInstanceExecute");
-  // Triton will not call this function simultaneously for the same
-  // 'instance'. But since this backend could be used by multiple
-  // instances from multiple models the implementation needs to handle
-  // multiple calls to this function at the same time (with different
-  // 'instance' objects). Best practice for a high-performance
-  // implementation is to avoid introducing mutex/lock and instead use
-  // only function-local and model-instance-specific state.
-  ModelInstanceState* instance_state;
-  RETURN_IF_ERROR(TRITONBACKEND_ModelInstanceState(
-      instance, reinterpret_cast<void**>(&instance_state)));
   ModelState* model_state = instance_state->StateForModel();
 
+  // Lazily loaded models load their library here on first use. If that
+  // fails no response was created yet, so Triton reports the error for
+  // every request.
+  ScopedLibraryPin library_pin(model_state);
+  RETURN_IF_ERROR(library_pin.Pin());
+  ModelLibrary* library = library_pin.Get();
+
   // 'responses' is initialized as a parallel array to 'requests',
   // with one TRITONBACKEND_Response object for each
   // TRITONBACKEND_Request object. If something goes wrong while
@@ -121,6 +287,10 @@ TRITONBACKEND_ModelInstanceExecute(
   // created, so use ProcessTensor arguments that cause collector to
   // manage it.
 
+  ExecutionTrace trace(requests, request_count);
+
+  PerfScope gather_perf(model_state->perf_stats.get(), PERF_PHASE_GATHER);
+  TraceSpan gather_span(&trace, TRACE_GATHER);
   BackendInputCollector collector(
       requests, request_count, &responses, model_state->TritonMemoryManager(),
       false /* pinned_enabled */, nullptr /* stream*/);
@@ -136,23 +306,63 @@ TRITONBACKEND_ModelInstanceExecute(
   const size_t num_inputs = model_state->input_tensors.size();
 
   OMTensor *om_inputs[num_inputs];
+  const char* in_buffers[num_inputs];
+  std::vector<std::vector<int64_t>> in_shapes(num_inputs);
 
-  LOG_MESSAGE(TRITONSERVER_LOG_VERBOSE,"onnxmlir create tensors");
-
+  bool inputs_valid = true;
+  // bytes gathered or converted into the instance's buffers that are
+  // bound to its NUMA node
+  uint64_t local_bytes = 0;
   for(size_t i = 0; i < num_inputs; i++){
-    TensorDef input_def = model_state->input_tensors[i];
-    const char* input_buffer;
-    size_t input_buffer_byte_size;
+    const TensorDef& input_def = model_state->input_tensors[i];
+    const char* input_buffer = nullptr;
+    size_t input_buffer_byte_size = 0;
     TRITONSERVER_MemoryType input_buffer_memory_type;
     int64_t input_buffer_memory_type_id;
+    om_inputs[i] = nullptr;
+    in_buffers[i] = nullptr;
+
+    // The compiled model's vectorized kernels need aligned inputs, so
+    // the batch is gathered into an aligned buffer of the instance
+    // unless the input of a single request can be used as is.
+    uint64_t batch_byte_size = 0;
+    bool in_place = false;
+    TRITONSERVER_Error* layout_err = InputBatchByteSize(
+        requests, request_count, input_def.name.c_str(),
+        model_state->input_alignment, &batch_byte_size, &in_place);
+    if(layout_err != nullptr){
+      RESPOND_ALL_AND_SET_NULL_IF_ERROR(responses, request_count, layout_err);
+      inputs_valid = false;
+      continue;
+    }
+    // Quantized inputs are dequantized into the aligned buffer after the
+    // gather, so the collector may place the integers anywhere.
+    char* existing_buffer = nullptr;
+    if(!in_place && !input_def.quantized){
+      existing_buffer = instance_state->InputBuffer(i)->Reserve(
+          batch_byte_size, model_state->input_alignment);
+      if(existing_buffer == nullptr){
+        RESPOND_ALL_AND_SET_NULL_IF_ERROR(responses, request_count,
+            TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INTERNAL,
+                ("failed to allocate " + std::to_string(batch_byte_size) +
+                 " bytes for input '" + input_def.name + "'").c_str()));
+        inputs_valid = false;
+        continue;
+      }
+      if(instance_state->InputBuffer(i)->Bound())
+        local_bytes += batch_byte_size;
+    }
 
-    RESPOND_ALL_AND_SET_NULL_IF_ERROR(
-        responses, request_count,
-        collector.ProcessTensor(
-            input_def.name.c_str(), nullptr /* existing_buffer */,
-            0 /* existing_buffer_byte_size */, allowed_input_types, &input_buffer,
-            &input_buffer_byte_size, &input_buffer_memory_type,
-            &input_buffer_memory_type_id));
+    TRITONSERVER_Error* gather_err = collector.ProcessTensor(
+        input_def.name.c_str(), existing_buffer,
+        existing_buffer ? batch_byte_size : 0, allowed_input_types, &input_buffer,
+        &input_buffer_byte_size, &input_buffer_memory_type,
+        &input_buffer_memory_type_id);
+    if(gather_err != nullptr){
+      RESPOND_ALL_AND_SET_NULL_IF_ERROR(responses, request_count, gather_err);
+      inputs_valid = false;
+      continue;
+    }
 
 
     TRITONBACKEND_Input* input;
@@ -164,20 +374,24 @@ TRITONBACKEND_ModelInstanceExecute(
     RETURN_IF_ERROR(
       TRITONBACKEND_InputProperties(input, nullptr, &datatype, &shape_ptr, &dims_count, nullptr, nullptr));
 
-    int64_t in_shape[dims_count];
-    std::copy(shape_ptr, shape_ptr + dims_count, in_shape);
-    if(model_state->supports_first_dim_batching) {
-      size_t features_size = input_def.dtype_size;
-      for(u_int32_t d = 1; d < dims_count; d++){
-        features_size *= shape_ptr[d];
-      } 
-      in_shape[0] = input_buffer_byte_size / features_size;
+    std::vector<int64_t>& in_shape = in_shapes[i];
+    in_shape.assign(shape_ptr, shape_ptr + dims_count);
+    if(model_state->supports_first_dim_batching)
+      in_shape[0] = input_def.BatchSize(shape_ptr, dims_count, input_buffer_byte_size);
+
+    // OMTensors are dense row major, so the buffer must hold exactly the
+    // elements of the shape.
+    if(input_buffer == nullptr ||
+       GetElementCount(in_shape) * input_def.dtype_size != (int64_t)input_buffer_byte_size){
+      RESPOND_ALL_AND_SET_NULL_IF_ERROR(responses, request_count,
+          TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG,
+              ("input '" + input_def.name + "' is not a contiguous tensor of its shape").c_str()));
+      inputs_valid = false;
+      continue;
     }
-    om_inputs[i] = model_state->dll_omTensorCreate((void* )input_buffer, in_shape, dims_count, input_def.om_dtype);
+    in_buffers[i] = input_buffer;
   }
 
-  OMTensorList *om_input_tl = model_state->dll_omTensorListCreate(om_inputs, num_inputs);
-
   // Finalize the collector. If 'true' is returned, 'input_buffer'
   // will not be valid until the backend synchronizes the CUDA
   // stream or event that was used when creating the collector. For
@@ -185,20 +399,72 @@ TRITONBACKEND_ModelInstanceExecute(
   // be needed; so if 'true' is returned simply log an error.
   const bool need_cuda_input_sync = collector.Finalize();
   if (need_cuda_input_sync) {
-    model_state->dll_omTensorListDestroy(om_input_tl);
+    inputs_valid = false;
     LOG_MESSAGE(
         TRITONSERVER_LOG_ERROR,
         "'onnxmlir' backend: unexpected CUDA sync required by collector");
   }
 
-  LOG_MESSAGE(TRITONSERVER_LOG_VERBOSE,"onnxmlir run_main_graph start");
+  // The model reads quantized inputs as floats.
+  for(size_t i = 0; i < num_inputs && inputs_valid; i++){
+    const TensorDef& input_def = model_state->input_tensors[i];
+    if(!input_def.quantized)
+      continue;
+    size_t count = GetElementCount(in_shapes[i]);
+    char* buffer = instance_state->InputBuffer(i)->Reserve(
+        count * input_def.om_dtype_size, model_state->input_alignment);
+    if(buffer == nullptr){
+      RESPOND_ALL_AND_SET_NULL_IF_ERROR(responses, request_count,
+          TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INTERNAL,
+              ("failed to allocate dequantized input '" + input_def.name + "'").c_str()));
+      inputs_valid = false;
+      break;
+    }
+    input_def.Dequantize(in_buffers[i], buffer, count);
+    in_buffers[i] = buffer;
+    if(instance_state->InputBuffer(i)->Bound())
+      local_bytes += count * input_def.om_dtype_size;
+  }
+  gather_span.End();
+  gather_perf.End();
+
+  LOG_VERBOSE("onnxmlir create tensors");
+  OMTensorList *om_input_tl = nullptr;
+  if(inputs_valid){
+    TraceSpan create_span(&trace, TRACE_TENSOR_CREATE);
+    for(size_t i = 0; i < num_inputs; i++){
+      om_inputs[i] = library->dll_omTensorCreate(
+          (void*)in_buffers[i], in_shapes[i].data(), in_shapes[i].size(),
+          model_state->input_tensors[i].om_dtype);
+    }
+    om_input_tl = library->dll_omTensorListCreate(om_inputs, num_inputs);
+  }
+
+  LOG_VERBOSE("onnxmlir run_main_graph start");
   //Run the Model
-  OMTensorList *om_output_tl = model_state->dll_run_main_graph(om_input_tl);
-  LOG_MESSAGE(TRITONSERVER_LOG_VERBOSE,"onnxmlir run_main_graph end");
+  PerfScope run_perf(model_state->perf_stats.get(), PERF_PHASE_RUN);
+  TraceSpan run_span(&trace, TRACE_RUN);
+  uint64_t run_start_ns, run_end_ns;
+  SET_TIMESTAMP(run_start_ns);
+  OMTensorList *om_output_tl = om_input_tl ? library->dll_run_main_graph(om_input_tl) : nullptr;
+  SET_TIMESTAMP(run_end_ns);
+  run_span.End();
+  run_perf.End();
+
+  // The shadow run happens later on another thread, so the sampled
+  // inputs have to be copied before the collector frees them.
+  std::unique_ptr<ShadowBatch> shadow_batch;
+  if(model_state->shadow && om_output_tl && model_state->shadow->Sample()){
+    shadow_batch.reset(new ShadowBatch());
+    shadow_batch->primary_ns = run_end_ns - run_start_ns;
+    for(size_t i = 0; i < num_inputs; i++)
+      shadow_batch->inputs.emplace_back(library, om_inputs[i], model_state->input_tensors[i].om_dtype_size);
+  }
+  LOG_VERBOSE("onnxmlir run_main_graph end");
 
-  model_state->dll_omTensorListDestroy(om_input_tl);
-  LOG_MESSAGE(
-      TRITONSERVER_LOG_VERBOSE,
+  if(om_input_tl)
+    library->dll_omTensorListDestroy(om_input_tl);
+  LOG_VERBOSE(
       (std::string("model ") + model_state->Name() + ": requests in batch " +
        std::to_string(request_count))
           .c_str());
@@ -211,13 +477,15 @@ TRITONBACKEND_ModelInstanceExecute(
   }
 
   int64_t config_output_size = model_state->output_tensors.size();
-  int64_t output_size = model_state->dll_omTensorListGetSize(om_output_tl);
-  if(output_size != config_output_size){
-    model_state->dll_omTensorListDestroy(om_output_tl);
+  int64_t output_size = om_output_tl ? library->dll_omTensorListGetSize(om_output_tl) : 0;
+  if(om_output_tl && output_size != config_output_size){
+    library->dll_omTensorListDestroy(om_output_tl);
+    om_output_tl = nullptr;
     RESPOND_ALL_AND_SET_NULL_IF_ERROR(
       responses, request_count,
       TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG, 
       ("Number of ouput Tensors missmatches config: " + std::to_string(config_output_size) + " actual: " + std::to_string(output_size)).c_str()));
+    output_size = 0;
   }
 
   // Because the output values are concatenated into a single contiguous
@@ -229,29 +497,76 @@ TRITONBACKEND_ModelInstanceExecute(
   // 'output_buffer' corresonding to each request's output into the
   // response for that request.
 
-  BackendOutputResponder responder(
-      requests, request_count, &responses, model_state->TritonMemoryManager(),
-      model_state->supports_first_dim_batching, false /* pinned_enabled */,
-      nullptr /* stream*/);
-
+  TraceSpan validate_span(&trace, TRACE_VALIDATE);
   for(int64_t i = 0; i < output_size; i++){
-    TensorDef output_def = model_state->output_tensors[i];
-    OMTensor *om_output = model_state->dll_omTensorListGetOmtByIndex(om_output_tl, i);
+    OMTensor *om_output = library->dll_omTensorListGetOmtByIndex(om_output_tl, i);
     std::string error;
-    if(!output_def.CheckTensorMatches(model_state, om_output, error)){
+    if(!model_state->output_tensors[i].CheckTensorMatches(library, om_output, error)){
       RESPOND_ALL_AND_SET_NULL_IF_ERROR(
       responses, request_count,
       TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INVALID_ARG, 
       ("model output: " + error).c_str()));
+      output_size = 0;
     }
-    void *output_buffer = model_state->dll_omTensorGetDataPtr(om_output);
+  }
+  validate_span.End();
+
+  if(shadow_batch && output_size == config_output_size){
+    for(int64_t i = 0; i < output_size; i++)
+      shadow_batch->outputs.emplace_back(
+          library, library->dll_omTensorListGetOmtByIndex(om_output_tl, i),
+          model_state->output_tensors[i].om_dtype_size);
+    model_state->shadow->Submit(std::move(shadow_batch));
+  }
+
+  PerfScope scatter_perf(model_state->perf_stats.get(), PERF_PHASE_SCATTER);
+  TraceSpan scatter_span(&trace, TRACE_SCATTER);
+  // Data of the outputs as sent to the clients, quantized outputs are
+  // converted from the model's floats first.
+  std::vector<const char*> output_data(output_size);
+  for(int64_t i = 0; i < output_size; i++){
+    const TensorDef& output_def = model_state->output_tensors[i];
+    OMTensor *om_output = library->dll_omTensorListGetOmtByIndex(om_output_tl, i);
+    output_data[i] = (const char*)library->dll_omTensorGetDataPtr(om_output);
+    if(!output_def.quantized)
+      continue;
+    size_t count = GetElementCount(library->dll_omTensorGetShape(om_output),
+                                   library->dll_omTensorGetRank(om_output));
+    char* buffer = instance_state->OutputBuffer(i)->Reserve(
+        count * output_def.dtype_size, ONNXMLIR_DEFAULT_ALIGNMENT);
+    if(buffer == nullptr){
+      RESPOND_ALL_AND_SET_NULL_IF_ERROR(responses, request_count,
+          TRITONSERVER_ErrorNew(TRITONSERVER_ERROR_INTERNAL,
+              ("failed to allocate quantized output '" + output_def.name + "'").c_str()));
+      output_size = 0;
+      break;
+    }
+    output_def.Quantize(output_data[i], buffer, count);
+    output_data[i] = buffer;
+    if(instance_state->OutputBuffer(i)->Bound())
+      local_bytes += count * output_def.dtype_size;
+  }
+
+  // Decoupled models stream their outputs as partial responses.
+  if(model_state->decoupled)
+    StreamResponses(model_state, library, requests, request_count, &responses,
+                    om_output_tl, output_data.data(), output_size);
+
+  BackendOutputResponder responder(
+      requests, request_count, &responses, model_state->TritonMemoryManager(),
+      model_state->supports_first_dim_batching, false /* pinned_enabled */,
+      nullptr /* stream*/);
+
+  for(int64_t i = 0; i < output_size && !model_state->decoupled; i++){
+    const TensorDef& output_def = model_state->output_tensors[i];
+    OMTensor *om_output = library->dll_omTensorListGetOmtByIndex(om_output_tl, i);
 
     //Process tensor might modify output_shape, so we copy it
-    int64_t rank = model_state->dll_omTensorGetRank(om_output);
-    int64_t *output_shape_ptr = model_state->dll_omTensorGetShape(om_output);
+    int64_t rank = library->dll_omTensorGetRank(om_output);
+    int64_t *output_shape_ptr = library->dll_omTensorGetShape(om_output);
     std::vector<int64_t> output_shape(output_shape_ptr, output_shape_ptr + rank);
     responder.ProcessTensor(
-      output_def.name, output_def.triton_dtype, output_shape, (const char*)output_buffer,
+      output_def.name, output_def.triton_dtype, output_shape, output_data[i],
       TRITONSERVER_MEMORY_CPU, 0);
   }
 
@@ -267,11 +582,15 @@ TRITONBACKEND_ModelInstanceExecute(
         TRITONSERVER_LOG_ERROR,
         "'onnxmlir' backend: unexpected CUDA sync required by responder");
   }
+  scatter_span.End();
+  scatter_perf.End();
 
-  model_state->dll_omTensorListDestroy(om_output_tl);
+  if(om_output_tl)
+    library->dll_omTensorListDestroy(om_output_tl);
 
   // Send all the responses that haven't already been sent because of
   // an earlier error.
+  TraceSpan send_span(&trace, TRACE_SEND);
   for (auto& response : responses) {
     if (response != nullptr) {
       LOG_IF_ERROR(
@@ -280,6 +599,11 @@ TRITONBACKEND_ModelInstanceExecute(
           "failed to send response");
     }
   }
+  send_span.End();
+
+  if(model_state->perf_stats)
+    model_state->perf_stats->ExecutionDone();
+  instance_state->AddNumaLocalBytes(local_bytes);
 
   // Done with the request objects so release them.
   for (uint32_t r = 0; r < request_count; ++r) {
@@ -292,6 +616,53 @@ TRITONBACKEND_ModelInstanceExecute(
   return nullptr;  // success
 }
 
+}  // namespace
+
+extern "C" {
+
+// When Triton calls TRITONBACKEND_ModelInstanceExecute it is required
+// that a backend create a response for each request in the batch. A
+// response may be the output tensors required for that request or may
+// be an error that is returned in the response.
+//
+TRITONSERVER_Error*
+TRITONBACKEND_ModelInstanceExecute(
+    TRITONBACKEND_ModelInstance* instance, TRITONBACKEND_Request** requests,
+    const uint32_t request_count)
+{
+  LOG_VERBOSE("onnxmlir ModelInstanceExecute");
+  // Triton will not call this function simultaneously for the same
+  // 'instance'. But since this backend could be used by multiple
+  // instances from multiple models the implementation needs to handle
+  // multiple calls to this function at the same time (with different
+  // 'instance' objects). Best practice for a high-performance
+  // implementation is to avoid introducing mutex/lock and instead use
+  // only function-local and model-instance-specific state.
+  ModelInstanceState* instance_state;
+  RETURN_IF_ERROR(TRITONBACKEND_ModelInstanceState(
+      instance, reinterpret_cast<void**>(&instance_state)));
+  ModelState* model_state = instance_state->StateForModel();
+
+  // NUMA bound instances execute on Triton's instance thread, pinned
+  // to the CPUs of their node on the first execute, even with the
+  // shared compute pool: the pool's threads may run on any node.
+  if(instance_state->NumaNode() >= 0){
+    instance_state->BindThread();
+    return ExecuteRequests(instance_state, requests, request_count);
+  }
+  if(model_state->compute_queue == nullptr)
+    return ExecuteRequests(instance_state, requests, request_count);
+
+  // With the shared compute pool the instance thread only hands the
+  // batch to the pool and sleeps, so no more threads than the pool
+  // size compete for the CPUs no matter how many instances exist.
+  TRITONSERVER_Error* err = nullptr;
+  model_state->compute_pool->Run(model_state->compute_queue, [&](){
+    err = ExecuteRequests(instance_state, requests, request_count);
+  });
+  return err;
+}
+
 }  // extern "C"
 
 }}}  // namespace triton::backend::onnxmlir
@@ -0,0 +1,58 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#include "onnxmlir_trace.h"
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+namespace {
+
+const char* TRACE_ACTIVITY_NAMES[TRACE_ACTIVITY_COUNT][2] = {
+    {"ONNXMLIR_GATHER_START", "ONNXMLIR_GATHER_END"},
+    {"ONNXMLIR_TENSOR_CREATE_START", "ONNXMLIR_TENSOR_CREATE_END"},
+    {"ONNXMLIR_RUN_MAIN_GRAPH_START", "ONNXMLIR_RUN_MAIN_GRAPH_END"},
+    {"ONNXMLIR_VALIDATE_START", "ONNXMLIR_VALIDATE_END"},
+    {"ONNXMLIR_SCATTER_START", "ONNXMLIR_SCATTER_END"},
+    {"ONNXMLIR_SEND_START", "ONNXMLIR_SEND_END"},
+};
+
+}  // namespace
+
+ExecutionTrace::ExecutionTrace(TRITONBACKEND_Request** requests, const uint32_t request_count){
+  for(uint32_t r = 0; r < request_count; r++){
+    TRITONSERVER_InferenceTrace* trace = nullptr;
+    // fails if the server was built without tracing support
+    TRITONSERVER_Error* err = TRITONBACKEND_RequestTrace(requests[r], &trace);
+    if(err != nullptr){
+      TRITONSERVER_ErrorDelete(err);
+      continue;
+    }
+    if(trace != nullptr)
+      traces_.push_back(trace);
+  }
+}
+
+void ExecutionTrace::Report(TraceActivity activity, bool start){
+  uint64_t timestamp_ns;
+  SET_TIMESTAMP(timestamp_ns);
+  const char* name = TRACE_ACTIVITY_NAMES[activity][start ? 0 : 1];
+  for(TRITONSERVER_InferenceTrace* trace : traces_){
+    LOG_IF_ERROR(
+        TRITONSERVER_InferenceTraceReportActivity(trace, timestamp_ns, name),
+        "failed to report trace activity");
+  }
+}
+
+TraceSpan::TraceSpan(ExecutionTrace *trace, TraceActivity activity)
+    : trace_(trace->Enabled() ? trace : nullptr), activity_(activity){
+  if(trace_)
+    trace_->Report(activity_, true);
+}
+
+void TraceSpan::End(){
+  if(!trace_)
+    return;
+  trace_->Report(activity_, false);
+  trace_ = nullptr;
+}
+
+}}}  // namespace triton::backend::onnxmlir
@@ -0,0 +1,69 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#ifndef ONNX_MLIR_TRACE_H
+#define ONNX_MLIR_TRACE_H
+
+#include <vector>
+#include "triton/backend/backend_common.h"
+#include "triton/core/tritonbackend.h"
+
+// Like LOG_MESSAGE at verbose level, but MSG is only evaluated when
+// verbose logging is enabled, so building the message costs nothing
+// in production.
+#define LOG_VERBOSE(MSG)                                       \
+  do {                                                         \
+    if (TRITONSERVER_LogIsEnabled(TRITONSERVER_LOG_VERBOSE))   \
+      LOG_MESSAGE(TRITONSERVER_LOG_VERBOSE, MSG);              \
+  } while (false)
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+// Activities of an execution reported to the Triton trace as
+// ONNXMLIR_<NAME>_START / ONNXMLIR_<NAME>_END pairs.
+enum TraceActivity {
+  TRACE_GATHER,
+  TRACE_TENSOR_CREATE,
+  TRACE_RUN,
+  TRACE_VALIDATE,
+  TRACE_SCATTER,
+  TRACE_SEND,
+  TRACE_ACTIVITY_COUNT
+};
+
+//
+// ExecutionTrace
+//
+// The Triton traces of the requests of a batch. Every activity of the
+// batch is reported to the trace of each traced request, so it shows
+// up in the trace file next to Triton's own timestamps.
+//
+class ExecutionTrace {
+ public:
+  ExecutionTrace(TRITONBACKEND_Request** requests, const uint32_t request_count);
+  bool Enabled() const { return !traces_.empty(); }
+  void Report(TraceActivity activity, bool start);
+
+ private:
+  std::vector<TRITONSERVER_InferenceTrace*> traces_;
+};
+
+//
+// TraceSpan
+//
+// Reports the start of 'activity' when constructed and its end on
+// End() or destruction.
+//
+class TraceSpan {
+ public:
+  TraceSpan(ExecutionTrace *trace, TraceActivity activity);
+  ~TraceSpan() { End(); }
+  void End();
+
+ private:
+  ExecutionTrace *trace_;
+  TraceActivity activity_;
+};
+
+}}}  // namespace triton::backend::onnxmlir
+
+#endif //ONNX_MLIR_TRACE_H
@@ -2,6 +2,8 @@
 
 #include "onnxmlir_typemapping.h"
 
+#include <cstring>
+
 namespace triton { namespace backend { namespace onnxmlir {
 
 OM_DATA_TYPE TritonDataTypeToOmDataType(TRITONSERVER_DataType datatype) 
@@ -36,32 +38,80 @@ OM_DATA_TYPE TritonDataTypeToOmDataType(TRITONSERVER_DataType datatype)
   }
 }
 
-const std::map<std::string, OM_DATA_TYPE> OM_DATA_TYPE_MLIR_TO_ONNX = {
-    {"i1", ONNX_TYPE_BOOL},   // bool  -> BOOL
-    {"i8", ONNX_TYPE_INT8},   // char  -> INT8 (platform dependent, can be UINT8)
-    {"si8", ONNX_TYPE_INT8},   // int8_t   -> INT8
-    {"ui8", ONNX_TYPE_UINT8},  // uint8_t  -> UINT8,  unsigned char  -> UNIT 8
-    {"i16", ONNX_TYPE_INT16},
-    {"si16", ONNX_TYPE_INT16},  // int16_t  -> INT16,  short          -> INT16
-    {"ui16", ONNX_TYPE_UINT16}, // uint16_t -> UINT16, unsigned short -> UINT16
-    {"i32", ONNX_TYPE_INT32},  // int32_t  -> INT32,  int            -> INT32
-    {"si32", ONNX_TYPE_INT32},
-    {"ui32", ONNX_TYPE_UINT32}, // uint32_t -> UINT32, unsigned int   -> UINT32
-    {"i64", ONNX_TYPE_INT64},  // int64_t  -> INT64,  long           -> INT64
-    {"si64", ONNX_TYPE_INT64},
-    {"ui64", ONNX_TYPE_UINT64}, // uint64_t -> UINT64, unsigned long  -> UINT64
-    {"f32", ONNX_TYPE_FLOAT},  // float    -> FLOAT
-    {"f64", ONNX_TYPE_DOUBLE}, // double   -> DOUBLE
-    {"!krnl.string", ONNX_TYPE_STRING},    // const char * -> STRING
-    {"complex<f32>", ONNX_TYPE_COMPLEX64},  // _Complex float -> COMPLEX64
-    {"complex<f64>", ONNX_TYPE_COMPLEX128}, // _Complex double -> COMPLEX128
+uint32_t TritonDataTypeByteSize(TRITONSERVER_DataType datatype)
+{
+  switch (datatype) {
+    case TRITONSERVER_TYPE_BOOL:
+    case TRITONSERVER_TYPE_UINT8:
+    case TRITONSERVER_TYPE_INT8:
+      return 1;
+    case TRITONSERVER_TYPE_UINT16:
+    case TRITONSERVER_TYPE_INT16:
+    case TRITONSERVER_TYPE_FP16:
+    case TRITONSERVER_TYPE_BF16:
+      return 2;
+    case TRITONSERVER_TYPE_UINT32:
+    case TRITONSERVER_TYPE_INT32:
+    case TRITONSERVER_TYPE_FP32:
+      return 4;
+    case TRITONSERVER_TYPE_UINT64:
+    case TRITONSERVER_TYPE_INT64:
+    case TRITONSERVER_TYPE_FP64:
+      return 8;
+    default:
+      // BYTES and INVALID have no fixed size.
+      return 0;
+  }
+}
+
+namespace {
+
+struct MlirDataType {
+  const char *name;
+  size_t length;
+  OM_DATA_TYPE om_dtype;
 };
 
-OM_DATA_TYPE MlirDataTypeToOmDataType(std::string datatype){
-  auto pos = OM_DATA_TYPE_MLIR_TO_ONNX.find(datatype);
-  if(pos == OM_DATA_TYPE_MLIR_TO_ONNX.end())
-    return ONNX_TYPE_UNDEFINED;
-  return pos->second;
+#define MLIR_TYPE(name, om_dtype) {name, sizeof(name) - 1, om_dtype}
+
+// Ordered by how common the types are in model signatures, a linear
+// scan comparing lengths first beats a map keyed by std::string for
+// so few entries.
+const MlirDataType MLIR_DATA_TYPES[] = {
+    MLIR_TYPE("f32", ONNX_TYPE_FLOAT),  // float    -> FLOAT
+    MLIR_TYPE("i64", ONNX_TYPE_INT64),  // int64_t  -> INT64,  long           -> INT64
+    MLIR_TYPE("i32", ONNX_TYPE_INT32),  // int32_t  -> INT32,  int            -> INT32
+    MLIR_TYPE("f64", ONNX_TYPE_DOUBLE), // double   -> DOUBLE
+    MLIR_TYPE("i1", ONNX_TYPE_BOOL),    // bool  -> BOOL
+    MLIR_TYPE("i8", ONNX_TYPE_INT8),    // char  -> INT8 (platform dependent, can be UINT8)
+    MLIR_TYPE("ui8", ONNX_TYPE_UINT8),  // uint8_t  -> UINT8,  unsigned char  -> UNIT 8
+    MLIR_TYPE("si8", ONNX_TYPE_INT8),   // int8_t   -> INT8
+    MLIR_TYPE("i16", ONNX_TYPE_INT16),
+    MLIR_TYPE("si16", ONNX_TYPE_INT16),  // int16_t  -> INT16,  short          -> INT16
+    MLIR_TYPE("ui16", ONNX_TYPE_UINT16), // uint16_t -> UINT16, unsigned short -> UINT16
+    MLIR_TYPE("si32", ONNX_TYPE_INT32),
+    MLIR_TYPE("ui32", ONNX_TYPE_UINT32), // uint32_t -> UINT32, unsigned int   -> UINT32
+    MLIR_TYPE("si64", ONNX_TYPE_INT64),
+    MLIR_TYPE("ui64", ONNX_TYPE_UINT64), // uint64_t -> UINT64, unsigned long  -> UINT64
+    MLIR_TYPE("!krnl.string", ONNX_TYPE_STRING),    // const char * -> STRING
+    MLIR_TYPE("complex<f32>", ONNX_TYPE_COMPLEX64),  // _Complex float -> COMPLEX64
+    MLIR_TYPE("complex<f64>", ONNX_TYPE_COMPLEX128), // _Complex double -> COMPLEX128
+};
+
+#undef MLIR_TYPE
+
+}  // namespace
+
+OM_DATA_TYPE MlirDataTypeToOmDataType(const char *datatype, size_t length){
+  for(const MlirDataType &type : MLIR_DATA_TYPES){
+    if(type.length == length && memcmp(type.name, datatype, length) == 0)
+      return type.om_dtype;
+  }
+  return ONNX_TYPE_UNDEFINED;
+}
+
+OM_DATA_TYPE MlirDataTypeToOmDataType(const std::string &datatype){
+  return MlirDataTypeToOmDataType(datatype.data(), datatype.size());
 }
 
 }}}  // namespace triton::backend::onnxmlir
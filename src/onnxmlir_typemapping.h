@@ -3,13 +3,17 @@
 #ifndef ONNX_MLIR_UTILS_H
 #define ONNX_MLIR_UTILS_H
 
+#include <string>
 #include "triton/core/tritonbackend.h"
 #include <OnnxMlirRuntime.h>
 
 namespace triton { namespace backend { namespace onnxmlir {
 
-OM_DATA_TYPE MlirDataTypeToOmDataType(std::string datatype);
+OM_DATA_TYPE MlirDataTypeToOmDataType(const char *datatype, size_t length);
+OM_DATA_TYPE MlirDataTypeToOmDataType(const std::string &datatype);
 OM_DATA_TYPE TritonDataTypeToOmDataType(TRITONSERVER_DataType datatype);
+// Same as TRITONSERVER_DataTypeByteSize, without a call into the server.
+uint32_t TritonDataTypeByteSize(TRITONSERVER_DataType datatype);
 
 }}}  // namespace triton::backend::onnxmlir
 
@@ -0,0 +1,203 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#include "perf_counters.h"
+
+#include "triton/backend/backend_common.h"
+
+#include <sstream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+namespace {
+
+const char *PERF_PHASE_NAMES[PERF_PHASE_COUNT] = {
+    "gather", "run_main_graph", "scatter"};
+const char *PERF_EVENT_NAMES[PERF_EVENT_COUNT] = {
+    "cycles", "instructions", "llc_misses", "branch_misses"};
+
+#ifdef __linux__
+const uint64_t PERF_EVENT_CONFIGS[PERF_EVENT_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+int OpenCounter(uint64_t config, int group_fd){
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = PERF_TYPE_HARDWARE;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                     PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // measure the calling thread on any cpu. Not inherited: the OpenMP
+  // threads run_main_graph fans out to exist before the counter and are
+  // shared by all models, so their work can not be attributed anyway.
+  return syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, PERF_FLAG_FD_CLOEXEC);
+}
+#endif
+
+// Only warn once per process about missing counters, not per thread.
+std::atomic<bool> unavailable_logged(false);
+
+}  // namespace
+
+PerfCounterGroup*
+PerfCounterGroup::ForCurrentThread(){
+  static thread_local PerfCounterGroup group;
+  return &group;
+}
+
+PerfCounterGroup::PerfCounterGroup(){
+  for(int e = 0; e < PERF_EVENT_COUNT; e++){
+    fds_[e] = -1;
+    order_[e] = -1;
+  }
+#ifdef __linux__
+  leader_fd_ = OpenCounter(PERF_EVENT_CONFIGS[PERF_EVENT_CYCLES], -1);
+  if(leader_fd_ == -1){
+    if(!unavailable_logged.exchange(true))
+      LOG_MESSAGE(TRITONSERVER_LOG_WARN,
+          (std::string("onnxmlir: hardware performance counters unavailable: ") +
+           strerror(errno)).c_str());
+    return;
+  }
+  fds_[PERF_EVENT_CYCLES] = leader_fd_;
+  order_[num_open_++] = PERF_EVENT_CYCLES;
+  for(int e = PERF_EVENT_CYCLES + 1; e < PERF_EVENT_COUNT; e++){
+    fds_[e] = OpenCounter(PERF_EVENT_CONFIGS[e], leader_fd_);
+    if(fds_[e] != -1)
+      order_[num_open_++] = e;
+  }
+#endif
+}
+
+PerfCounterGroup::~PerfCounterGroup(){
+#ifdef __linux__
+  for(int e = 0; e < PERF_EVENT_COUNT; e++){
+    if(fds_[e] != -1)
+      close(fds_[e]);
+  }
+#endif
+}
+
+uint32_t PerfCounterGroup::SupportedMask() const {
+  uint32_t mask = 0;
+  for(int e = 0; e < PERF_EVENT_COUNT; e++){
+    if(fds_[e] != -1)
+      mask |= 1u << e;
+  }
+  return mask;
+}
+
+bool PerfCounterGroup::Read(uint64_t *values){
+  if(!Available())
+    return false;
+#ifdef __linux__
+  // layout for PERF_FORMAT_GROUP with both time fields:
+  // nr, time_enabled, time_running, value[nr]
+  uint64_t buffer[3 + PERF_EVENT_COUNT];
+  ssize_t bytes = read(leader_fd_, buffer, sizeof(buffer));
+  if(bytes < (ssize_t)(3 * sizeof(uint64_t)) || buffer[0] != (uint64_t)num_open_)
+    return false;
+  uint64_t enabled = buffer[1];
+  uint64_t running = buffer[2];
+  for(int e = 0; e < PERF_EVENT_COUNT; e++)
+    values[e] = 0;
+  for(int i = 0; i < num_open_; i++){
+    uint64_t value = buffer[3 + i];
+    // the group was multiplexed with other events, extrapolate
+    if(running != 0 && running < enabled)
+      value = (uint64_t)((double)value * enabled / running);
+    values[order_[i]] = value;
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+PerfStats::PerfStats(const std::string &model_name, uint64_t log_interval)
+    : model_name_(model_name), log_interval_(log_interval ? log_interval : 1),
+      executions_(0), supported_(0){
+  for(int p = 0; p < PERF_PHASE_COUNT; p++){
+    for(int e = 0; e < PERF_EVENT_COUNT; e++)
+      totals_[p][e] = 0;
+  }
+}
+
+PerfStats::~PerfStats(){
+  if(executions_ > 0)
+    Log();
+}
+
+void PerfStats::Add(PerfPhase phase, uint32_t supported, const uint64_t *begin, const uint64_t *end){
+  supported_.fetch_or(supported, std::memory_order_relaxed);
+  for(int e = 0; e < PERF_EVENT_COUNT; e++){
+    if(end[e] > begin[e])
+      totals_[phase][e].fetch_add(end[e] - begin[e], std::memory_order_relaxed);
+  }
+}
+
+void PerfStats::ExecutionDone(){
+  if(executions_.fetch_add(1, std::memory_order_relaxed) + 1 < log_interval_)
+    return;
+  std::lock_guard<std::mutex> lock(log_mutex_);
+  // another instance may have dumped the window in the meantime
+  if(executions_ >= log_interval_)
+    Log();
+}
+
+void PerfStats::Log(){
+  uint64_t executions = executions_.exchange(0);
+  uint32_t supported = supported_.load();
+  if(executions == 0)
+    return;
+  std::ostringstream msg;
+  msg << "onnxmlir perf counters for model '" << model_name_ << "', average of "
+      << executions << " executions on the executing thread only, work of the"
+      << " model's OpenMP threads is not counted:";
+  for(int p = 0; p < PERF_PHASE_COUNT; p++){
+    uint64_t totals[PERF_EVENT_COUNT];
+    for(int e = 0; e < PERF_EVENT_COUNT; e++)
+      totals[e] = totals_[p][e].exchange(0);
+    msg << "\n  " << PERF_PHASE_NAMES[p] << ":";
+    for(int e = 0; e < PERF_EVENT_COUNT; e++){
+      msg << " " << PERF_EVENT_NAMES[e] << "=";
+      if(supported & (1u << e))
+        msg << totals[e] / executions;
+      else
+        msg << "n/a";
+    }
+    if(totals[PERF_EVENT_CYCLES] != 0 && (supported & (1u << PERF_EVENT_INSTRUCTIONS)))
+      msg << " ipc=" << (double)totals[PERF_EVENT_INSTRUCTIONS] / totals[PERF_EVENT_CYCLES];
+  }
+  LOG_MESSAGE(TRITONSERVER_LOG_INFO, msg.str().c_str());
+}
+
+PerfScope::PerfScope(PerfStats *stats, PerfPhase phase): stats_(stats), phase_(phase){
+  if(!stats_)
+    return;
+  group_ = PerfCounterGroup::ForCurrentThread();
+  if(!group_->Read(begin_))
+    group_ = nullptr;
+}
+
+void PerfScope::End(){
+  if(!group_)
+    return;
+  uint64_t end[PERF_EVENT_COUNT];
+  if(group_->Read(end))
+    stats_->Add(phase_, group_->SupportedMask(), begin_, end);
+  group_ = nullptr;
+}
+
+}}}  // namespace triton::backend::onnxmlir
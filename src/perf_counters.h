@@ -0,0 +1,106 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#ifndef ONNX_MLIR_PERF_COUNTERS_H
+#define ONNX_MLIR_PERF_COUNTERS_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+// Phases of TRITONBACKEND_ModelInstanceExecute that are profiled.
+enum PerfPhase {
+  PERF_PHASE_GATHER,
+  PERF_PHASE_RUN,
+  PERF_PHASE_SCATTER,
+  PERF_PHASE_COUNT
+};
+
+// Hardware events sampled for each phase.
+enum PerfEvent {
+  PERF_EVENT_CYCLES,
+  PERF_EVENT_INSTRUCTIONS,
+  PERF_EVENT_LLC_MISSES,
+  PERF_EVENT_BRANCH_MISSES,
+  PERF_EVENT_COUNT
+};
+
+//
+// PerfCounterGroup
+//
+// A perf_event_open counter group measuring the calling thread. Counters
+// only count for the thread that opened them, so there is one group per
+// thread, created on first use by ForCurrentThread(). Threads the model
+// runs work on (OpenMP) are not measured. Events the host
+// does not support (containers, VMs, perf_event_paranoid) are left out;
+// if not even the cycle counter can be opened the group is unavailable
+// and Read() always fails.
+//
+class PerfCounterGroup {
+ public:
+  static PerfCounterGroup* ForCurrentThread();
+  ~PerfCounterGroup();
+  bool Available() const { return leader_fd_ != -1; }
+  // Bit mask of the events that could be opened.
+  uint32_t SupportedMask() const;
+  // Reads the current counter values, scaled for multiplexing.
+  // Unsupported events read as 0.
+  bool Read(uint64_t *values);
+
+ private:
+  PerfCounterGroup();
+  int leader_fd_ = -1;
+  int fds_[PERF_EVENT_COUNT];
+  // group read order of the opened events
+  int order_[PERF_EVENT_COUNT];
+  int num_open_ = 0;
+};
+
+//
+// PerfStats
+//
+// Counter totals per phase aggregated over all instances of a model.
+// Every 'log_interval' executions the averages per execution are
+// written to the log and the totals are reset.
+//
+class PerfStats {
+ public:
+  PerfStats(const std::string &model_name, uint64_t log_interval);
+  ~PerfStats();
+  void Add(PerfPhase phase, uint32_t supported, const uint64_t *begin, const uint64_t *end);
+  void ExecutionDone();
+
+ private:
+  void Log();
+  std::string model_name_;
+  uint64_t log_interval_;
+  std::atomic<uint64_t> totals_[PERF_PHASE_COUNT][PERF_EVENT_COUNT];
+  std::atomic<uint64_t> executions_;
+  std::atomic<uint32_t> supported_;
+  std::mutex log_mutex_;
+};
+
+//
+// PerfScope
+//
+// Samples the counters of the current thread between construction and
+// End() (or destruction) and adds the difference to 'stats'. Does
+// nothing if 'stats' is nullptr.
+//
+class PerfScope {
+ public:
+  PerfScope(PerfStats *stats, PerfPhase phase);
+  ~PerfScope() { End(); }
+  void End();
+
+ private:
+  PerfStats *stats_;
+  PerfPhase phase_;
+  PerfCounterGroup *group_ = nullptr;
+  uint64_t begin_[PERF_EVENT_COUNT];
+};
+
+}}}  // namespace triton::backend::onnxmlir
+
+#endif //ONNX_MLIR_PERF_COUNTERS_H
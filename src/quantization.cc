@@ -0,0 +1,63 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#include "quantization.h"
+
+#include <limits>
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+namespace {
+
+// 1.5 * 2^23: adding and subtracting it rounds half to even any float
+// of at most 2^22 in magnitude, and unlike nearbyint vectorizes without
+// SSE4.1.
+const float ROUNDING_BIAS = 12582912.0f;
+// Quotients beyond this saturate anyway.
+const float ROUNDING_LIMIT = 4194304.0f;
+
+template <typename Q>
+void DequantizeLinear(const Q *src, float *dst, size_t count, float scale, int32_t zero_point){
+  for(size_t i = 0; i < count; i++)
+    dst[i] = (float)((int32_t)src[i] - zero_point) * scale;
+}
+
+template <typename Q>
+void QuantizeLinear(const float *src, Q *dst, size_t count, float scale, int32_t zero_point){
+  const float lowest = std::numeric_limits<Q>::min();
+  const float highest = std::numeric_limits<Q>::max();
+  for(size_t i = 0; i < count; i++){
+    // divide rather than multiply by 1 / scale, which rounds ties of
+    // the quotient differently
+    float value = src[i] / scale;
+    // clamp into the range the bias rounds exactly, written so NaN
+    // ends up as -ROUNDING_LIMIT and then 'lowest'
+    value = value > -ROUNDING_LIMIT ? value : -ROUNDING_LIMIT;
+    value = value < ROUNDING_LIMIT ? value : ROUNDING_LIMIT;
+    // round before adding the zero point, as ONNX QuantizeLinear
+    value = (value + ROUNDING_BIAS) - ROUNDING_BIAS;
+    value += (float)zero_point;
+    value = value > lowest ? value : lowest;
+    value = value < highest ? value : highest;
+    dst[i] = (Q)(int32_t)value;
+  }
+}
+
+}  // namespace
+
+void Dequantize(const int8_t *src, float *dst, size_t count, float scale, int32_t zero_point){
+  DequantizeLinear(src, dst, count, scale, zero_point);
+}
+
+void Dequantize(const uint8_t *src, float *dst, size_t count, float scale, int32_t zero_point){
+  DequantizeLinear(src, dst, count, scale, zero_point);
+}
+
+void Quantize(const float *src, int8_t *dst, size_t count, float scale, int32_t zero_point){
+  QuantizeLinear(src, dst, count, scale, zero_point);
+}
+
+void Quantize(const float *src, uint8_t *dst, size_t count, float scale, int32_t zero_point){
+  QuantizeLinear(src, dst, count, scale, zero_point);
+}
+
+}}}  // namespace triton::backend::onnxmlir
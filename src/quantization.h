@@ -0,0 +1,25 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#ifndef ONNX_MLIR_QUANTIZATION_H
+#define ONNX_MLIR_QUANTIZATION_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+// Linear (de)quantization as ONNX DequantizeLinear / QuantizeLinear:
+// real = (q - zero_point) * scale, q = saturate(round(real / scale) + zero_point)
+// with rounding half to even. NaN quantizes to the lowest value.
+//
+// The loops are plain so the compiler vectorizes them for the target
+// (SSE/AVX, NEON, z/Architecture vector facility) instead of using
+// intrinsics of one of them.
+void Dequantize(const int8_t *src, float *dst, size_t count, float scale, int32_t zero_point);
+void Dequantize(const uint8_t *src, float *dst, size_t count, float scale, int32_t zero_point);
+void Quantize(const float *src, int8_t *dst, size_t count, float scale, int32_t zero_point);
+void Quantize(const float *src, uint8_t *dst, size_t count, float scale, int32_t zero_point);
+
+}}}  // namespace triton::backend::onnxmlir
+
+#endif //ONNX_MLIR_QUANTIZATION_H
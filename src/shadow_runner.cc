@@ -0,0 +1,194 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#include "shadow_runner.h"
+
+#include "triton/backend/backend_common.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+namespace {
+
+uint64_t NowNs(){
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Whether all elements of 'actual' are within 'atol' + 'rtol' * |expected|
+// of 'expected' (as numpy.allclose). The maximum absolute difference is
+// returned in 'max_diff'.
+template <typename T>
+bool AllClose(const char *expected, const char *actual, size_t count,
+              double atol, double rtol, double *max_diff){
+  const T *x = (const T*)expected;
+  const T *y = (const T*)actual;
+  bool close = true;
+  *max_diff = 0;
+  for(size_t i = 0; i < count; i++){
+    double diff = std::fabs((double)x[i] - (double)y[i]);
+    // NaN in only one of the outputs counts as infinitely different
+    if(diff != diff)
+      diff = (x[i] != x[i] && y[i] != y[i]) ? 0 : INFINITY;
+    if(diff > atol + rtol * std::fabs((double)x[i]))
+      close = false;
+    if(diff > *max_diff)
+      *max_diff = diff;
+  }
+  return close;
+}
+
+}  // namespace
+
+ShadowTensor::ShadowTensor(const ModelLibrary *library, OMTensor *tensor, uint32_t dtype_size)
+    : dtype(library->dll_omTensorGetDataType(tensor)), dtype_size(dtype_size){
+  int64_t rank = library->dll_omTensorGetRank(tensor);
+  int64_t *shape_ptr = library->dll_omTensorGetShape(tensor);
+  shape.assign(shape_ptr, shape_ptr + rank);
+  const char *ptr = (const char*)library->dll_omTensorGetDataPtr(tensor);
+  data.assign(ptr, ptr + GetElementCount(shape) * dtype_size);
+}
+
+ShadowRunner::ShadowRunner(
+    const std::string &model_name, ModelLibraryRegistry *registry,
+    ModelLibrary *candidate, double sample_rate, uint64_t log_interval,
+    double atol, double rtol)
+    : model_name_(model_name), registry_(registry), candidate_(candidate),
+      sample_rate_(sample_rate), log_interval_(log_interval ? log_interval : 1),
+      atol_(atol), rtol_(rtol),
+      batches_seen_(0), busy_(false), dropped_since_log_(0){
+  worker_ = std::thread(&ShadowRunner::WorkerLoop, this);
+}
+
+ShadowRunner::~ShadowRunner(){
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_one();
+  worker_.join();
+  if(compared_ > 0)
+    Log();
+  registry_->Release(candidate_);
+}
+
+bool ShadowRunner::Sample(){
+  // spread the samples evenly: batch n is sampled when n * rate crosses
+  // an integer
+  uint64_t n = batches_seen_.fetch_add(1, std::memory_order_relaxed);
+  if((uint64_t)((n + 1) * sample_rate_) <= (uint64_t)(n * sample_rate_))
+    return false;
+  // drop the sample before the caller copies the batch for nothing
+  if(busy_.load(std::memory_order_acquire)){
+    dropped_since_log_.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void ShadowRunner::Submit(std::unique_ptr<ShadowBatch> batch){
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // another request thread won the race since Sample()
+    if(busy_.load(std::memory_order_relaxed)){
+      dropped_since_log_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    pending_ = std::move(batch);
+    busy_.store(true, std::memory_order_release);
+  }
+  cv_.notify_one();
+}
+
+void ShadowRunner::WorkerLoop(){
+  while(true){
+    std::unique_ptr<ShadowBatch> batch;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this](){ return stop_ || pending_; });
+      if(stop_)
+        return;
+      batch = std::move(pending_);
+    }
+    Compare(*batch);
+    busy_.store(false, std::memory_order_release);
+    if(compared_ + failed_ >= log_interval_)
+      Log();
+  }
+}
+
+void ShadowRunner::Compare(const ShadowBatch &batch){
+  const ModelLibrary *lib = candidate_;
+  std::vector<OMTensor*> om_inputs;
+  for(const ShadowTensor &input : batch.inputs){
+    om_inputs.push_back(lib->dll_omTensorCreate(
+        (void*)input.data.data(), (int64_t*)input.shape.data(), input.shape.size(), input.dtype));
+  }
+  OMTensorList *om_input_tl = lib->dll_omTensorListCreate(om_inputs.data(), om_inputs.size());
+  uint64_t start_ns = NowNs();
+  OMTensorList *om_output_tl = lib->dll_run_main_graph(om_input_tl);
+  uint64_t candidate_ns = NowNs() - start_ns;
+  lib->dll_omTensorListDestroy(om_input_tl);
+  if(!om_output_tl){
+    failed_++;
+    return;
+  }
+
+  compared_++;
+  primary_ns_ += batch.primary_ns;
+  candidate_ns_ += candidate_ns;
+  bool divergent = lib->dll_omTensorListGetSize(om_output_tl) != (int64_t)batch.outputs.size();
+  for(size_t i = 0; i < batch.outputs.size() && !divergent; i++){
+    const ShadowTensor &expected = batch.outputs[i];
+    OMTensor *om_output = lib->dll_omTensorListGetOmtByIndex(om_output_tl, i);
+    int64_t rank = lib->dll_omTensorGetRank(om_output);
+    int64_t *shape = lib->dll_omTensorGetShape(om_output);
+    if(lib->dll_omTensorGetDataType(om_output) != expected.dtype ||
+       std::vector<int64_t>(shape, shape + rank) != expected.shape){
+      divergent = true;
+      break;
+    }
+    const char *actual = (const char*)lib->dll_omTensorGetDataPtr(om_output);
+    size_t count = expected.data.size() / std::max<uint32_t>(expected.dtype_size, 1);
+    // builds with different compiler flags rarely match bit for bit, so
+    // floating point outputs only diverge beyond the tolerance
+    double diff = 0;
+    if(expected.dtype == ONNX_TYPE_FLOAT)
+      divergent = !AllClose<float>(expected.data.data(), actual, count, atol_, rtol_, &diff);
+    else if(expected.dtype == ONNX_TYPE_DOUBLE)
+      divergent = !AllClose<double>(expected.data.data(), actual, count, atol_, rtol_, &diff);
+    else if(memcmp(expected.data.data(), actual, expected.data.size()) != 0)
+      divergent = true;
+    if(diff > max_abs_diff_)
+      max_abs_diff_ = diff;
+  }
+  if(divergent)
+    divergent_++;
+  lib->dll_omTensorListDestroy(om_output_tl);
+}
+
+void ShadowRunner::Log(){
+  std::ostringstream msg;
+  msg << "onnxmlir shadow of model '" << model_name_ << "' (" << candidate_->Path()
+      << "): " << compared_ << " batches compared";
+  if(compared_ > 0){
+    double primary_us = primary_ns_ / 1000.0 / compared_;
+    double candidate_us = candidate_ns_ / 1000.0 / compared_;
+    msg << ", primary " << primary_us << " us, candidate " << candidate_us
+        << " us per batch (speedup " << primary_us / candidate_us << ")"
+        << ", " << divergent_ << " with outputs beyond atol " << atol_ << " rtol " << rtol_
+        << ", max abs diff "
+        << max_abs_diff_;
+  }
+  msg << ", " << failed_ << " failed, "
+      << dropped_since_log_.exchange(0) << " samples dropped while busy";
+  LOG_MESSAGE(TRITONSERVER_LOG_INFO, msg.str().c_str());
+  compared_ = failed_ = divergent_ = primary_ns_ = candidate_ns_ = 0;
+  max_abs_diff_ = 0;
+}
+
+}}}  // namespace triton::backend::onnxmlir
@@ -0,0 +1,92 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+#ifndef ONNX_MLIR_SHADOW_RUNNER_H
+#define ONNX_MLIR_SHADOW_RUNNER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "model_library.h"
+
+#include <OnnxMlirRuntime.h>
+
+namespace triton { namespace backend { namespace onnxmlir {
+
+// Owned copy of an OMTensor.
+struct ShadowTensor {
+  std::vector<int64_t> shape;
+  OM_DATA_TYPE dtype;
+  uint32_t dtype_size;
+  std::vector<char> data;
+  ShadowTensor(const ModelLibrary *library, OMTensor *tensor, uint32_t dtype_size);
+};
+
+// A sampled batch: the inputs and the answer of the primary library.
+struct ShadowBatch {
+  std::vector<ShadowTensor> inputs;
+  std::vector<ShadowTensor> outputs;
+  uint64_t primary_ns;
+};
+
+//
+// ShadowRunner
+//
+// Runs a sampled fraction of the batches of a model a second time
+// through a candidate build of the model on a background thread and
+// compares latency and outputs against the primary build. Responses
+// are always taken from the primary; if the candidate is still busy
+// with the previous batch, a new sample is dropped by Sample(), before
+// the batch is copied, rather than queued so the shadow never builds up
+// a backlog. Floating point outputs count
+// as divergent when they differ by more than 'atol' + 'rtol' * |primary|.
+//
+class ShadowRunner {
+ public:
+  ShadowRunner(const std::string &model_name, ModelLibraryRegistry *registry,
+               ModelLibrary *candidate, double sample_rate, uint64_t log_interval,
+               double atol, double rtol);
+  ~ShadowRunner();
+  // Whether the current batch should be shadowed, false while the
+  // candidate is busy with the previous sample.
+  bool Sample();
+  void Submit(std::unique_ptr<ShadowBatch> batch);
+
+ private:
+  void WorkerLoop();
+  void Compare(const ShadowBatch &batch);
+  void Log();
+
+  std::string model_name_;
+  ModelLibraryRegistry *registry_;
+  ModelLibrary *candidate_;
+  double sample_rate_;
+  uint64_t log_interval_;
+  double atol_;
+  double rtol_;
+  std::atomic<uint64_t> batches_seen_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::unique_ptr<ShadowBatch> pending_;
+  // a batch is pending or being compared
+  std::atomic<bool> busy_;
+  bool stop_ = false;
+  std::thread worker_;
+
+  // statistics, only touched by the worker
+  uint64_t compared_ = 0;
+  uint64_t failed_ = 0;
+  uint64_t divergent_ = 0;
+  uint64_t primary_ns_ = 0;
+  uint64_t candidate_ns_ = 0;
+  double max_abs_diff_ = 0;
+  std::atomic<uint64_t> dropped_since_log_;
+};
+
+}}}  // namespace triton::backend::onnxmlir
+
+#endif //ONNX_MLIR_SHADOW_RUNNER_H
@@ -0,0 +1,112 @@
+// Copyright contributors to the onnxmlir-triton-backend project
+
+// Checks the quantization kernels against ONNX QuantizeLinear /
+// DequantizeLinear: q = saturate(rint(real / scale) + zero_point).
+// Exits with 1 on the first mismatch.
+
+#include <cfenv>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+#include "quantization.h"
+
+using namespace triton::backend::onnxmlir;
+
+namespace {
+
+int failures = 0;
+
+template <typename Q>
+void Check(float real, float scale, int32_t zero_point, int expected){
+  Q q;
+  Quantize(&real, &q, 1, scale, zero_point);
+  if((int)q != expected){
+    printf("Quantize(%.9g, scale=%.9g, zero_point=%d) = %d, expected %d\n",
+           real, scale, zero_point, (int)q, expected);
+    failures++;
+  }
+}
+
+// Reference in the order of the ONNX specification.
+template <typename Q>
+int Reference(float real, float scale, int32_t zero_point){
+  if(std::isnan(real))
+    return std::numeric_limits<Q>::min();
+  double value = std::nearbyint(real / scale) + zero_point;
+  value = std::max(value, (double)std::numeric_limits<Q>::min());
+  value = std::min(value, (double)std::numeric_limits<Q>::max());
+  return (int)value;
+}
+
+template <typename Q>
+void Sweep(float scale, int32_t zero_point){
+  std::vector<float> real;
+  for(int k = -600; k <= 600; k++){
+    // ties and their neighbouring floats
+    float tie = (k + 0.5f) * scale;
+    real.push_back(tie);
+    real.push_back(std::nextafter(tie, -INFINITY));
+    real.push_back(std::nextafter(tie, INFINITY));
+  }
+  real.push_back(1e30f);
+  real.push_back(-1e30f);
+  real.push_back(INFINITY);
+  real.push_back(-INFINITY);
+  std::vector<Q> q(real.size());
+  Quantize(real.data(), q.data(), real.size(), scale, zero_point);
+  for(size_t i = 0; i < real.size(); i++){
+    int expected = Reference<Q>(real[i], scale, zero_point);
+    if((int)q[i] != expected){
+      printf("Quantize(%.9g, scale=%.9g, zero_point=%d) = %d, expected %d\n",
+             real[i], scale, zero_point, (int)q[i], expected);
+      failures++;
+    }
+  }
+}
+
+}  // namespace
+
+int main(){
+  std::fesetround(FE_TONEAREST);
+
+  // ties round to even before the zero point is added
+  Check<uint8_t>(0.5f, 1.0f, 1, 1);
+  Check<uint8_t>(1.5f, 1.0f, 1, 3);
+  Check<uint8_t>(2.5f, 1.0f, 1, 3);
+  Check<uint8_t>(2.5f, 1.0f, 0, 2);
+  Check<int8_t>(-0.5f, 1.0f, -1, -1);
+  Check<int8_t>(-1.5f, 1.0f, 3, 1);
+  // saturation and NaN
+  Check<uint8_t>(300.0f, 1.0f, 0, 255);
+  Check<uint8_t>(-1.0f, 1.0f, 0, 0);
+  Check<int8_t>(200.0f, 1.0f, 0, 127);
+  Check<int8_t>(-200.0f, 1.0f, 0, -128);
+  Check<int8_t>(NAN, 1.0f, 0, -128);
+
+  const float scales[] = {1.0f, 0.1f, 0.0078125f, 0.3f, 3.7f};
+  const int32_t zero_points[] = {0, 1, 127, 128};
+  for(float scale : scales){
+    for(int32_t zero_point : zero_points){
+      Sweep<uint8_t>(scale, zero_point);
+      Sweep<int8_t>(scale, zero_point < 128 ? zero_point : -zero_point);
+    }
+  }
+
+  // dequantization is exact for these scales
+  const uint8_t wire[] = {0, 1, 128, 255};
+  float real[4];
+  Dequantize(wire, real, 4, 0.5f, 128);
+  if(real[0] != -64.0f || real[1] != -63.5f || real[2] != 0.0f || real[3] != 63.5f){
+    printf("Dequantize(scale=0.5, zero_point=128) = %g %g %g %g\n",
+           real[0], real[1], real[2], real[3]);
+    failures++;
+  }
+
+  if(failures){
+    printf("%d quantization checks failed\n", failures);
+    return 1;
+  }
+  printf("quantization checks passed\n");
+  return 0;
+}